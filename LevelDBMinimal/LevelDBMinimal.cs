@@ -13,6 +13,10 @@ namespace BoundingBoxes {
         // Custom delegate to support ReadOnlySpan<byte> (ref structs cannot be used in Action<T>)
         public delegate void DBKeyValueDelegate(ReadOnlySpan<byte> key, ReadOnlySpan<byte> value);
 
+        // One finished wave of BatchGetStreaming: keys [start, start + offsets.Length). Offsets index into dataBlock,
+        // which is only valid during the call.
+        public delegate void BatchWaveDelegate(int start, IntPtr dataBlock, ReadOnlySpan<int> offsets, ReadOnlySpan<int> lengths, ReadOnlySpan<byte> found);
+
         [LibraryImport("kernel32", SetLastError = true, StringMarshalling = StringMarshalling.Utf16)]
         private static partial IntPtr LoadLibraryW(string lpFileName);
 
@@ -28,10 +32,155 @@ namespace BoundingBoxes {
             }
         }
 
+        // Mirrors CallStatus in LevelDBMinimal.cpp. Cancelled and DeadlineExceeded mean the results are partial.
+        public enum CallStatus {
+            Invalid = -1,
+            Ok = 0,
+            Cancelled = 1,
+            DeadlineExceeded = 2,
+        }
+
+        // Mirrors HugePageMode in LevelDBMinimal.cpp. Explicit needs reserved huge pages (vm.nr_hugepages on
+        // Linux, the Lock Pages in Memory right on Windows); file mappings only ever get transparent ones.
+        public enum HugePages {
+            Off = 0,
+            Transparent = 1,
+            Explicit = 2,
+        }
+
+        // A flag in native memory that long-running calls poll while they run, so they can be stopped from
+        // another thread. Hook it to a CancellationToken with token.Register(flag.Cancel).
+        public sealed class NativeCancelFlag : IDisposable {
+            private int* _flag = (int*)NativeMemory.AllocZeroed(sizeof(int));
+            internal int* Pointer => _flag;
+
+            public void Cancel() { if (_flag != null) Volatile.Write(ref *_flag, 1); }
+            public void Reset() { if (_flag != null) Volatile.Write(ref *_flag, 0); }
+
+            public void Dispose() {
+                if (_flag != null) {
+                    NativeMemory.Free(_flag);
+                    _flag = null;
+                }
+            }
+        }
+
+        // Mirrors DBOptions in LevelDBMinimal.cpp; only ever append fields.
+        [StructLayout(LayoutKind.Sequential)]
+        public struct DBOptions {
+            public int MaxOpenTables; // <= 0 uses the native default
+            public int PreopenTables; // Non-zero opens tables concurrently at open/update instead of on first touch
+            public byte* SnapshotPath; // Set by the constructor from its snapshotPath argument
+            public int VerifyChecksums; // Non-zero checks block and log record CRCs so torn reads are rejected
+            public long BlockCacheBytes; // Budget for decompressed blocks kept between lookups; <= 0 uses the native default (32 MiB)
+            public long SecondaryCacheBytes; // Budget for blocks the block cache evicts, kept LZ4 packed; <= 0 disables the tier
+            public int LocationHints; // Slots (64 bytes each) remembering where each key was last found; <= 0 disables hints
+            public byte* ChunkIndexPath; // Set by the constructor from its chunkIndexPath argument
+            public int DisableReadAhead; // Non-zero leaves batch lookups to fault their blocks in one seek at a time; for measuring
+
+            public static DBOptions Default => new() { MaxOpenTables = 512 };
+        }
+
+        // Mirrors TableSetStats in LevelDBMinimal.cpp.
+        [StructLayout(LayoutKind.Sequential)]
+        public struct TableSetStats {
+            public ulong Generation;
+            public uint ActiveTables;
+            public uint OpenTables;
+            public ulong RetiredTables;
+            public ulong ClosedRetiredTables;
+            public ulong ChunkIndexKeys;
+        }
+
+        // Mirrors BlockCacheStats in LevelDBMinimal.cpp.
+        [StructLayout(LayoutKind.Sequential)]
+        public struct BlockCacheStats {
+            public ulong PrimaryBytes;
+            public ulong SecondaryBytes;
+            public ulong SecondaryHits;   // Block cache misses served from the secondary tier
+            public ulong SecondaryMisses; // Block cache misses that went back to the file
+            public ulong DemotedBlocks;
+            public ulong DemotedBytes;    // Decompressed size of the demoted blocks
+            public ulong PackedBytes;     // What they were packed down to
+            public ulong HintHits;        // Lookups answered from a location hint
+            public ulong HintMisses;
+        }
+
+        // Mirrors LatencyHistogram in LevelDBMinimal.cpp: 4 log-linear buckets per power of two from 256 ns,
+        // the first and last bucket also catching everything below and above.
+        [StructLayout(LayoutKind.Sequential)]
+        public struct LatencyHistogram {
+            public const int BucketCount = 96;
+
+            public ulong Count;
+            public ulong TotalNanos;
+            public ulong MaxNanos;
+            public fixed ulong Buckets[BucketCount];
+
+            public static ulong BucketLowerBoundNanos(int bucket) {
+                int shift = 8 + bucket / 4;
+                return (1UL << shift) + (ulong)(bucket % 4) * (1UL << (shift - 2));
+            }
+        }
+
+        // Mirrors DBStats in LevelDBMinimal.cpp; only ever append fields.
+        [StructLayout(LayoutKind.Sequential)]
+        public struct DBStats {
+            public ulong KeysLookedUp;
+            public ulong TablesProbed;
+            public ulong TablesSkipped;   // Ruled out by key range without touching the table
+            public ulong TableCacheHits;
+            public ulong TableCacheMisses;
+            public ulong BlocksRead;
+            public ulong BlockBytesRead;
+            public ulong BytesCopied;
+            public ulong SessionKeys;
+            public ulong KeysIterated;
+
+            public LatencyHistogram OpenDB;
+            public LatencyHistogram UpdateDB;
+            public LatencyHistogram UpdateLogSession;
+            public LatencyHistogram BatchLookup;   // One range of a batch on one worker
+            public LatencyHistogram SessionLookup; // One key
+            public LatencyHistogram Iterate;
+            public LatencyHistogram ParallelFor;
+        }
+
+        // Mirrors RenderBox in LevelDBMinimal.cpp.
+        [StructLayout(LayoutKind.Sequential)]
+        public struct RenderBox {
+            public const uint Full = 1;    // Volume marked full in its structure data
+            public const uint Village = 2; // Village bounds
+
+            public int MinX, MinY, MinZ;
+            public int MaxX, MaxY, MaxZ;
+            public uint Flags;
+        }
+
+        // Mirrors ResultFrame in LevelDBMinimal.cpp.
+        [StructLayout(LayoutKind.Sequential)]
+        public struct ResultFrame {
+            public ulong Generation;
+            public RenderBox* Boxes;
+            public int Count;
+            public int Capacity;
+            public uint Truncated;
+            public int CenterX, CenterZ, Dimension;
+            public uint Complete; // Zero while further rings of the query are still streaming in
+        }
+
         [LibraryImport(Dll)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
         private static partial IntPtr OpenDB(byte* path);
 
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial IntPtr OpenDBWithOptions(byte* path, DBOptions* options);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial long BuildChunkIndex(byte* dbPath, byte tag, byte* outPath);
+
         [LibraryImport(Dll)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
         [return: MarshalAs(UnmanagedType.I1)]
@@ -43,7 +192,7 @@ namespace BoundingBoxes {
 
         [LibraryImport(Dll)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
-        private static partial void BatchGetFlat(
+        private static partial CallStatus BatchGetFlat(
             IntPtr db,
             byte* flatKeys,
             int* keyOffsets,
@@ -52,26 +201,70 @@ namespace BoundingBoxes {
             out byte* outDataBlock,
             int* outDataOffsets,
             int* outDataLengths,
-            byte* outFound
+            byte* outFound,
+            int* cancelFlag,
+            long deadlineMicros
         );
 
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static partial bool Prefetch(IntPtr db, byte* flatKeys, int* keyOffsets, int* keyLengths, int count);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static partial bool PrefetchChunkRect(IntPtr db, int minX, int minZ, int maxX, int maxZ, int dim, byte tag);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial void GetTableSetStats(IntPtr db, TableSetStats* stats);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial void GetBlockCacheStats(IntPtr db, BlockCacheStats* stats);
+
         // Delegate for iteration callback from Native C++
         [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
         private delegate void IterateCallback(byte* key, int keyLen, byte* val, int valLen);
 
         [LibraryImport(Dll)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
-        private static partial void IterateDB(
+        private static partial CallStatus IterateDB(
             IntPtr db,
             byte* prefix, int prefixLen,
             byte* suffix, int suffixLen,
-            IterateCallback callback
+            IterateCallback callback,
+            int* cancelFlag,
+            long deadlineMicros
+        );
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate void WaveCallback(int start, int count, byte* dataBlock, int* dataOffsets, int* dataLengths, byte* found);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial CallStatus BatchGetStreaming(
+            IntPtr db,
+            byte* flatKeys,
+            int* keyOffsets,
+            int* keyLengths,
+            int count,
+            int* waveEnds,
+            int waveCount,
+            WaveCallback callback,
+            int* cancelFlag,
+            long deadlineMicros
         );
 
         [LibraryImport(Dll)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
         private static partial IntPtr OpenLogSession(byte* dbPath);
 
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial IntPtr OpenLogSessionWithOptions(byte* dbPath, DBOptions* options);
+
         [LibraryImport(Dll)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
         private static partial void CloseLogSession(IntPtr session);
@@ -83,7 +276,7 @@ namespace BoundingBoxes {
 
         [LibraryImport(Dll)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
-        private static partial void BatchGetSessionFlat(
+        private static partial CallStatus BatchGetSessionFlat(
             IntPtr session,
             byte* flatKeys,
             int* keyOffsets,
@@ -92,9 +285,81 @@ namespace BoundingBoxes {
             out byte* outDataBlock,
             int* outDataOffsets,
             int* outDataLengths,
-            byte* outFound
+            byte* outFound,
+            int* cancelFlag,
+            long deadlineMicros
         );
 
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial IntPtr CreateResultRing(int capacity);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial void DestroyResultRing(IntPtr ring);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial ResultFrame* AcquireLatestFrame(IntPtr ring);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial CallStatus QueryChunkBoxes(IntPtr db, IntPtr session, int cx, int cz, int radius, int dim, IntPtr ring, int* cancelFlag, long deadlineMicros);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial IntPtr StartTracker(byte* dbPath, DBOptions* options, int radius, int capacity);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial void SetPosition(IntPtr tracker, int x, int z, int dim);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial ResultFrame* GetLatest(IntPtr tracker);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial void StopTracker(IntPtr tracker);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial void GetStats(DBStats* stats);
+
+        // Library-wide; GetStats reports relative to the last reset.
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        public static partial void ResetStats();
+
+        // Library-wide; applies to mappings and buffers created afterwards. Off by default.
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        private static partial int SetHugePages(int mode);
+
+        // Span tracing into per-thread rings; off by default.
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        public static partial void SetTraceEnabled([MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        public static partial void ClearTrace();
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static partial bool DumpTrace(byte* path);
+
+        // Logs every exported call to a binary trace for leveldbminimal_replay; off by default.
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static partial bool StartRecording(byte* path);
+
+        [LibraryImport(Dll)]
+        [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
+        public static partial void StopRecording();
+
         [LibraryImport(Dll)]
         [UnmanagedCallConv(CallConvs = new Type[] { typeof(CallConvCdecl) })]
         internal static partial void FreeBuffer(byte* buffer);
@@ -109,6 +374,45 @@ namespace BoundingBoxes {
             fixed (byte* p = buffer) { _nativeDb = OpenDB(p); }
         }
 
+        // snapshotPath names an optional metadata sidecar that makes the next open of the same world warm.
+        // chunkIndexPath names an index written by BuildChunkIndex; it is ignored once the tables change.
+        public LevelDBMinimal(string path, DBOptions options, string? snapshotPath = null, string? chunkIndexPath = null) {
+            var utf8ByteCount = Encoding.UTF8.GetByteCount(path);
+            Span<byte> buffer = stackalloc byte[utf8ByteCount + 1];
+            Encoding.UTF8.GetBytes(path, buffer);
+            buffer[utf8ByteCount] = 0;
+
+            byte[]? snapshotBytes = null;
+            if (!string.IsNullOrEmpty(snapshotPath)) {
+                snapshotBytes = new byte[Encoding.UTF8.GetByteCount(snapshotPath) + 1];
+                Encoding.UTF8.GetBytes(snapshotPath, snapshotBytes);
+            }
+            byte[]? chunkIndexBytes = null;
+            if (!string.IsNullOrEmpty(chunkIndexPath)) {
+                chunkIndexBytes = new byte[Encoding.UTF8.GetByteCount(chunkIndexPath) + 1];
+                Encoding.UTF8.GetBytes(chunkIndexPath, chunkIndexBytes);
+            }
+
+            fixed (byte* p = buffer)
+            fixed (byte* pSnapshot = snapshotBytes)
+            fixed (byte* pChunkIndex = chunkIndexBytes) {
+                options.SnapshotPath = pSnapshot;
+                options.ChunkIndexPath = pChunkIndex;
+                _nativeDb = OpenDBWithOptions(p, &options);
+            }
+        }
+
+        // Writes a perfect-hash index over every chunk key with the given tag for a world that no longer
+        // changes; returns the number of keys indexed, or -1 on failure.
+        public static long BuildChunkIndex(string dbPath, byte tag, string outPath) {
+            byte[] dbBytes = new byte[Encoding.UTF8.GetByteCount(dbPath) + 1];
+            Encoding.UTF8.GetBytes(dbPath, dbBytes);
+            byte[] outBytes = new byte[Encoding.UTF8.GetByteCount(outPath) + 1];
+            Encoding.UTF8.GetBytes(outPath, outBytes);
+            fixed (byte* pDb = dbBytes)
+            fixed (byte* pOut = outBytes) { return BuildChunkIndex(pDb, tag, pOut); }
+        }
+
         public void Dispose() {
             if (_nativeDb != IntPtr.Zero) {
                 CloseDB(_nativeDb);
@@ -126,8 +430,8 @@ namespace BoundingBoxes {
         }
 
         // Updated to use DBKeyValueDelegate instead of Action<...>
-        public void Iterate(string? prefix, string? suffix, DBKeyValueDelegate handler) {
-            if (_nativeDb == IntPtr.Zero) return;
+        public CallStatus Iterate(string? prefix, string? suffix, DBKeyValueDelegate handler, NativeCancelFlag? cancel = null, long deadlineMicros = 0) {
+            if (_nativeDb == IntPtr.Zero) return CallStatus.Invalid;
 
             // Marshal prefix
             byte[]? prefixBytes = null;
@@ -150,16 +454,18 @@ namespace BoundingBoxes {
                 handler(new ReadOnlySpan<byte>(kPtr, kLen), new ReadOnlySpan<byte>(vPtr, vLen));
             };
 
+            CallStatus status;
             fixed (byte* pPrefix = prefixBytes)
             fixed (byte* pSuffix = suffixBytes) {
-                IterateDB(_nativeDb, pPrefix, prefixLen, pSuffix, suffixLen, cb);
+                status = IterateDB(_nativeDb, pPrefix, prefixLen, pSuffix, suffixLen, cb, cancel != null ? cancel.Pointer : null, deadlineMicros);
             }
 
             // GC.KeepAlive to prevent delegate from being collected while native code runs
             GC.KeepAlive(cb);
+            return status;
         }
 
-        public void BatchGetRaw(
+        public CallStatus BatchGetRaw(
             ReadOnlySpan<byte> flatKeys,
             ReadOnlySpan<int> keyOffsets,
             ReadOnlySpan<int> keyLengths,
@@ -167,21 +473,211 @@ namespace BoundingBoxes {
             int[] outOffsets,
             int[] outLengths,
             byte[] outFound,
-            Action<IntPtr, int[], int[], byte[], int> resultHandler) {
+            Action<IntPtr, int[], int[], byte[], int> resultHandler,
+            NativeCancelFlag? cancel = null,
+            long deadlineMicros = 0) {
 
             byte* pResultBlock = null;
+            CallStatus status;
             fixed (byte* pFlatKeys = flatKeys)
             fixed (int* pKeyOffsets = keyOffsets)
             fixed (int* pKeyLengths = keyLengths)
             fixed (int* pOutOffsets = outOffsets)
             fixed (int* pOutLengths = outLengths)
             fixed (byte* pOutFound = outFound) {
-                BatchGetFlat(_nativeDb, pFlatKeys, pKeyOffsets, pKeyLengths, count, out pResultBlock, pOutOffsets, pOutLengths, pOutFound);
+                status = BatchGetFlat(_nativeDb, pFlatKeys, pKeyOffsets, pKeyLengths, count, out pResultBlock, pOutOffsets, pOutLengths, pOutFound,
+                    cancel != null ? cancel.Pointer : null, deadlineMicros);
                 if (pResultBlock != null) {
                     resultHandler((nint)pResultBlock, outOffsets, outLengths, outFound, count);
                     FreeBuffer(pResultBlock);
                 }
             }
+            return status;
+        }
+
+        // Runs the keys wave by wave in the given order and hands each wave to handler as soon as it is done.
+        // waveEnds holds the exclusive end of each wave; order keys nearest first to get near results first.
+        public CallStatus BatchGetStreamed(
+            ReadOnlySpan<byte> flatKeys,
+            ReadOnlySpan<int> keyOffsets,
+            ReadOnlySpan<int> keyLengths,
+            int count,
+            ReadOnlySpan<int> waveEnds,
+            BatchWaveDelegate handler,
+            NativeCancelFlag? cancel = null,
+            long deadlineMicros = 0) {
+            if (_nativeDb == IntPtr.Zero) return CallStatus.Invalid;
+
+            // Keep delegate alive
+            WaveCallback cb = (start, n, block, offs, lens, found) => {
+                handler(start, (nint)block, new ReadOnlySpan<int>(offs, n), new ReadOnlySpan<int>(lens, n), new ReadOnlySpan<byte>(found, n));
+            };
+
+            CallStatus status;
+            fixed (byte* pFlatKeys = flatKeys)
+            fixed (int* pKeyOffsets = keyOffsets)
+            fixed (int* pKeyLengths = keyLengths)
+            fixed (int* pWaveEnds = waveEnds) {
+                status = BatchGetStreaming(_nativeDb, pFlatKeys, pKeyOffsets, pKeyLengths, count, pWaveEnds, waveEnds.Length, cb,
+                    cancel != null ? cancel.Pointer : null, deadlineMicros);
+            }
+            GC.KeepAlive(cb);
+            return status;
+        }
+
+        // Starts warming the table blocks for these keys in the background. Returns false if a previous
+        // prefetch is still running. Must be called from the same thread that calls Update.
+        public bool PrefetchKeys(ReadOnlySpan<byte> flatKeys, ReadOnlySpan<int> keyOffsets, ReadOnlySpan<int> keyLengths, int count) {
+            if (_nativeDb == IntPtr.Zero) return false;
+            fixed (byte* pFlatKeys = flatKeys)
+            fixed (int* pKeyOffsets = keyOffsets)
+            fixed (int* pKeyLengths = keyLengths) {
+                return Prefetch(_nativeDb, pFlatKeys, pKeyOffsets, pKeyLengths, count);
+            }
+        }
+
+        public bool PrefetchChunks(int minX, int minZ, int maxX, int maxZ, int dimension, byte tag) {
+            if (_nativeDb == IntPtr.Zero) return false;
+            return PrefetchChunkRect(_nativeDb, minX, minZ, maxX, maxZ, dimension, tag);
+        }
+
+        // Counters and latencies summed over every thread and handle in the library.
+        public static DBStats GetStats() {
+            DBStats stats = default;
+            GetStats(&stats);
+            return stats;
+        }
+
+        // Returns the mode actually in effect, which falls back towards Off when the machine can't provide the request.
+        public static HugePages SetHugePages(HugePages mode) => (HugePages)SetHugePages((int)mode);
+
+        // Writes the recorded spans as Chrome trace-event JSON, viewable in chrome://tracing or Perfetto.
+        public static bool DumpTrace(string path) {
+            var utf8ByteCount = Encoding.UTF8.GetByteCount(path);
+            Span<byte> buffer = stackalloc byte[utf8ByteCount + 1];
+            Encoding.UTF8.GetBytes(path, buffer);
+            buffer[utf8ByteCount] = 0;
+            fixed (byte* p = buffer) { return DumpTrace(p); }
+        }
+
+        public static bool StartRecording(string path) {
+            var utf8ByteCount = Encoding.UTF8.GetByteCount(path);
+            Span<byte> buffer = stackalloc byte[utf8ByteCount + 1];
+            Encoding.UTF8.GetBytes(path, buffer);
+            buffer[utf8ByteCount] = 0;
+            fixed (byte* p = buffer) { return StartRecording(p); }
+        }
+
+        public TableSetStats GetTableStats() {
+            TableSetStats stats = default;
+            if (_nativeDb != IntPtr.Zero) GetTableSetStats(_nativeDb, &stats);
+            return stats;
+        }
+
+        public BlockCacheStats GetCacheStats() {
+            BlockCacheStats stats = default;
+            if (_nativeDb != IntPtr.Zero) GetBlockCacheStats(_nativeDb, &stats);
+            return stats;
+        }
+
+        // Looks up the AABB volumes around chunk (cx, cz), plus village bounds, and publishes them into ring.
+        // Only one thread may query into a given ring at a time.
+        public CallStatus QueryBoxes(LogSession? session, int cx, int cz, int radius, int dimension, ResultRing ring, NativeCancelFlag? cancel = null, long deadlineMicros = 0) {
+            if (_nativeDb == IntPtr.Zero) return CallStatus.Invalid;
+            return QueryChunkBoxes(_nativeDb, session?.NativeHandle ?? IntPtr.Zero, cx, cz, radius, dimension, ring.NativeHandle,
+                cancel != null ? cancel.Pointer : null, deadlineMicros);
+        }
+
+        // Native-owned, triple-buffered box results. One thread queries into it while another reads the
+        // latest frame without locks or managed allocations.
+        public class ResultRing : IDisposable {
+            private IntPtr _ringPtr;
+            public IntPtr NativeHandle => _ringPtr;
+
+            public ResultRing(int capacity) {
+                _ringPtr = CreateResultRing(capacity);
+            }
+
+            // The returned span stays valid until the next call, which must come from the same thread.
+            public ReadOnlySpan<RenderBox> Latest(out ulong generation) {
+                generation = 0;
+                if (_ringPtr == IntPtr.Zero) return default;
+                ResultFrame* frame = AcquireLatestFrame(_ringPtr);
+                generation = frame->Generation;
+                return new ReadOnlySpan<RenderBox>(frame->Boxes, frame->Count);
+            }
+
+            public void Dispose() {
+                if (_ringPtr != IntPtr.Zero) {
+                    DestroyResultRing(_ringPtr);
+                    _ringPtr = IntPtr.Zero;
+                }
+                GC.SuppressFinalize(this);
+            }
+        }
+
+        // Runs the whole refresh (directory updates, lookups, village scan) on a native thread. The host
+        // posts positions and reads the newest frame; everything else stays off managed threads.
+        public class Tracker : IDisposable {
+            private IntPtr _trackerPtr;
+            public IntPtr NativeHandle => _trackerPtr;
+
+            public Tracker(string dbPath, int radius, int capacity) {
+                var utf8ByteCount = Encoding.UTF8.GetByteCount(dbPath);
+                Span<byte> buffer = stackalloc byte[utf8ByteCount + 1];
+                Encoding.UTF8.GetBytes(dbPath, buffer);
+                buffer[utf8ByteCount] = 0;
+                fixed (byte* p = buffer) { _trackerPtr = StartTracker(p, null, radius, capacity); }
+            }
+
+            // snapshotPath and chunkIndexPath as for the LevelDBMinimal(string, DBOptions, ...) constructor.
+            public Tracker(string dbPath, DBOptions options, int radius, int capacity, string? snapshotPath = null, string? chunkIndexPath = null) {
+                var utf8ByteCount = Encoding.UTF8.GetByteCount(dbPath);
+                Span<byte> buffer = stackalloc byte[utf8ByteCount + 1];
+                Encoding.UTF8.GetBytes(dbPath, buffer);
+                buffer[utf8ByteCount] = 0;
+
+                byte[]? snapshotBytes = null;
+                if (!string.IsNullOrEmpty(snapshotPath)) {
+                    snapshotBytes = new byte[Encoding.UTF8.GetByteCount(snapshotPath) + 1];
+                    Encoding.UTF8.GetBytes(snapshotPath, snapshotBytes);
+                }
+                byte[]? chunkIndexBytes = null;
+                if (!string.IsNullOrEmpty(chunkIndexPath)) {
+                    chunkIndexBytes = new byte[Encoding.UTF8.GetByteCount(chunkIndexPath) + 1];
+                    Encoding.UTF8.GetBytes(chunkIndexPath, chunkIndexBytes);
+                }
+
+                fixed (byte* p = buffer)
+                fixed (byte* pSnapshot = snapshotBytes)
+                fixed (byte* pChunkIndex = chunkIndexBytes) {
+                    options.SnapshotPath = pSnapshot;
+                    options.ChunkIndexPath = pChunkIndex;
+                    _trackerPtr = StartTracker(p, &options, radius, capacity);
+                }
+            }
+
+            // Cheap; rapid calls are coalesced and only the newest position is queried.
+            public void SetPosition(int chunkX, int chunkZ, int dimension) {
+                if (_trackerPtr != IntPtr.Zero) LevelDBMinimal.SetPosition(_trackerPtr, chunkX, chunkZ, dimension);
+            }
+
+            // Same contract as ResultRing.Latest.
+            public ReadOnlySpan<RenderBox> Latest(out ulong generation) {
+                generation = 0;
+                if (_trackerPtr == IntPtr.Zero) return default;
+                ResultFrame* frame = GetLatest(_trackerPtr);
+                generation = frame->Generation;
+                return new ReadOnlySpan<RenderBox>(frame->Boxes, frame->Count);
+            }
+
+            public void Dispose() {
+                if (_trackerPtr != IntPtr.Zero) {
+                    StopTracker(_trackerPtr);
+                    _trackerPtr = IntPtr.Zero;
+                }
+                GC.SuppressFinalize(this);
+            }
         }
 
         public class LogSession : IDisposable {
@@ -196,6 +692,17 @@ namespace BoundingBoxes {
                 fixed (byte* p = buffer) { _sessionPtr = OpenLogSession(p); }
             }
 
+            // Only VerifyChecksums is taken from options.
+            public LogSession(string dbPath, DBOptions options) {
+                var utf8ByteCount = Encoding.UTF8.GetByteCount(dbPath);
+                Span<byte> buffer = stackalloc byte[utf8ByteCount + 1];
+                Encoding.UTF8.GetBytes(dbPath, buffer);
+                buffer[utf8ByteCount] = 0;
+                options.SnapshotPath = null;
+                options.ChunkIndexPath = null;
+                fixed (byte* p = buffer) { _sessionPtr = OpenLogSessionWithOptions(p, &options); }
+            }
+
             public bool Update(string logDir) {
                 if (_sessionPtr == IntPtr.Zero) return false;
                 var utf8ByteCount = Encoding.UTF8.GetByteCount(logDir);
@@ -205,7 +712,7 @@ namespace BoundingBoxes {
                 fixed (byte* p = buffer) { return UpdateLogSession(_sessionPtr, p); }
             }
 
-            public void BatchGetRaw(
+            public CallStatus BatchGetRaw(
                 ReadOnlySpan<byte> flatKeys,
                 ReadOnlySpan<int> keyOffsets,
                 ReadOnlySpan<int> keyLengths,
@@ -213,21 +720,26 @@ namespace BoundingBoxes {
                 int[] outOffsets,
                 int[] outLengths,
                 byte[] outFound,
-                Action<IntPtr, int[], int[], byte[], int> resultHandler) {
+                Action<IntPtr, int[], int[], byte[], int> resultHandler,
+                NativeCancelFlag? cancel = null,
+                long deadlineMicros = 0) {
 
                 byte* pResultBlock = null;
+                CallStatus status;
                 fixed (byte* pFlatKeys = flatKeys)
                 fixed (int* pKeyOffsets = keyOffsets)
                 fixed (int* pKeyLengths = keyLengths)
                 fixed (int* pOutOffsets = outOffsets)
                 fixed (int* pOutLengths = outLengths)
                 fixed (byte* pOutFound = outFound) {
-                    BatchGetSessionFlat(_sessionPtr, pFlatKeys, pKeyOffsets, pKeyLengths, count, out pResultBlock, pOutOffsets, pOutLengths, pOutFound);
+                    status = BatchGetSessionFlat(_sessionPtr, pFlatKeys, pKeyOffsets, pKeyLengths, count, out pResultBlock, pOutOffsets, pOutLengths, pOutFound,
+                        cancel != null ? cancel.Pointer : null, deadlineMicros);
                     if (pResultBlock != null) {
                         resultHandler((nint)pResultBlock, outOffsets, outLengths, outFound, count);
                         FreeBuffer(pResultBlock);
                     }
                 }
+                return status;
             }
 
             public void Dispose() {
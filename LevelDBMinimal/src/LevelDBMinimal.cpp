@@ -1,6 +1,7 @@
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
+#include <cstdio>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -10,58 +11,829 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <algorithm>
+#include <cmath>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <future> 
 #include <atomic>
 #include <queue>
+#include <mutex>
+#include <bit>
+#if defined(_M_X64) || defined(__x86_64__)
+#include <xmmintrin.h>
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#ifdef __linux__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+#include <charconv>
+#include <utility>
+#include <thread>
+#include <condition_variable>
+#include <optional>
+#include <chrono>
 
 #include "leveldb/table.h"
 #include "leveldb/env.h"
 #include "leveldb/options.h"
 #include "leveldb/iterator.h"
+#include "leveldb/cache.h"
+#ifdef LEVELDBMINIMAL_WITH_ZSTD
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
 
+#ifdef _WIN32
 #define EXPORT __declspec(dllexport)
+#else
+#define EXPORT __attribute__((visibility("default")))
+#endif
 
 using namespace std::literals;
 
 static unsigned int g_threadCount = 0;
 
+constexpr int32_t kDefaultMaxOpenTables = 512;
+constexpr int64_t kDefaultBlockCacheBytes = 32 << 20;
+
+// Mirrors LevelDBMinimal.DBOptions on the managed side; only ever append fields.
+struct DBOptions {
+    int32_t maxOpenTables = kDefaultMaxOpenTables;
+    int32_t preopenTables = 0; // Non-zero opens tables up front (up to maxOpenTables) instead of on first touch
+    const char* snapshotPath = nullptr; // Optional metadata sidecar, read on open and rewritten on close
+    int32_t verifyChecksums = 0; // Non-zero checks block and log record CRCs, so torn reads are rejected instead of parsed
+    int64_t blockCacheBytes = 0; // Budget for decompressed blocks kept between lookups; <= 0 uses kDefaultBlockCacheBytes
+    int64_t secondaryCacheBytes = 0; // Budget for blocks the block cache evicts, kept LZ4 packed; <= 0 disables the tier
+    int32_t locationHints = 0; // Slots (64 bytes each) remembering where each key was last found; <= 0 disables hints
+    const char* chunkIndexPath = nullptr; // Optional BuildChunkIndex output, used while it still matches the directory's tables
+    int32_t disableReadAhead = 0; // Non-zero leaves batch lookups to fault their blocks in one seek at a time; for measuring
+};
+
+// A table's entry in the table cache. Shared by every SSTable copy that refers to the same file,
+// so the open handle is dropped only when the last table set holding the file is gone, i.e.
+// after every reader that could still be probing a retired table has finished.
+struct CacheSlot {
+    leveldb::Cache* cache = nullptr;
+    uint64_t id = 0;
+    std::atomic<uint64_t>* closedRetired = nullptr;
+    mutable std::atomic<bool> retired = false;
+
+    CacheSlot(leveldb::Cache* c, std::atomic<uint64_t>* closed) : cache(c), id(c->NewId()), closedRetired(closed) {}
+    CacheSlot(const CacheSlot&) = delete;
+    CacheSlot& operator=(const CacheSlot&) = delete;
+    ~CacheSlot() {
+        char buf[sizeof(id)];
+        memcpy(buf, &id, sizeof(buf));
+        cache->Erase(leveldb::Slice(buf, sizeof(buf)));
+        if (retired) closedRetired->fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// A table file known to the db. Only metadata lives here; the file itself is opened on first
+// touch through BedrockDB::tableCache and may be closed again when the cache evicts it.
 struct SSTable {
     std::string path;
+    uint64_t number = 0;
     uint64_t fileSize = 0;
+    std::shared_ptr<const CacheSlot> slot;
+    int level = 0;
+    bool hasRange = false;
+    std::string smallest, largest; // User keys, from the MANIFEST
+};
+
+// A parsed leveldb block: prefix-compressed entries followed by the restart offset array.
+struct BlockView {
+    const uint8_t* data = nullptr;
+    uint32_t restartsOffset = 0; // Where the entries end
+    uint32_t numRestarts = 0;
+};
+
+// Value stored in the table cache.
+struct OpenTable {
     leveldb::RandomAccessFile* file = nullptr;
     leveldb::Table* table = nullptr;
+    const uint8_t* mapped = nullptr; // Non-null when file is a MappedTableFile
+    uint64_t fileSize = 0;
+    uint64_t cacheId = 0; // CacheSlot::id, which also keys the table's blocks in the block cache
+    bool verify = false;
+    // Index block for native point lookups; data is null when the table can only go through leveldb.
+    BlockView index;
+    std::unique_ptr<uint8_t[]> indexStorage; // Set when the index block is compressed
 };
 
-struct BedrockDB {
-    std::vector<std::unique_ptr<SSTable>> tables;
+struct ManifestEntry {
+    int level = 0;
+    std::string smallest, largest; // User keys
+};
+
+// Live file set replayed from the MANIFEST that CURRENT points at. Parsing resumes from offset
+// so a refresh only reads the version edits appended since the last one.
+struct ManifestState {
+    std::string name;
+    uint64_t offset = 0;
+    bool valid = false;
+    bool corrupt = false;
+    std::unordered_map<uint64_t, ManifestEntry> files;
+};
+
+// Immutable version of the table list in lookup order. UpdateDB builds the next version off to
+// the side and publishes it with one atomic store; readers load the current version once per call
+// and keep it alive, so a refresh never frees or reorders tables under a running lookup.
+struct ChunkIndex;
+
+struct TableSet {
+    std::vector<std::shared_ptr<const SSTable>> tables;
     std::unordered_map<std::string, size_t> pathIndex;
+    uint64_t generation = 0;
+    std::shared_ptr<const ChunkIndex> chunkIndex; // Only on the set OpenDB built; UpdateDB's sets go without
+};
+
+// Mirrors LevelDBMinimal.TableSetStats on the managed side; only ever append fields.
+struct TableSetStats {
+    uint64_t generation;
+    uint32_t activeTables;
+    uint32_t openTables;          // Includes retired tables still pinned by a reader
+    uint64_t retiredTables;       // Dropped from the active set: deleted, obsolete or rewritten
+    uint64_t closedRetiredTables; // Retired tables whose handles have actually been released
+    uint64_t chunkIndexKeys;      // Keys in the chunk index in use, 0 when there is none
+};
+
+// Mirrors LevelDBMinimal.BlockCacheStats on the managed side; only ever append fields.
+struct BlockCacheStats {
+    uint64_t primaryBytes;    // Charged to the block cache
+    uint64_t secondaryBytes;  // Charged to the secondary tier; 0 when it is disabled
+    uint64_t secondaryHits;   // Block cache misses served by unpacking a demoted block
+    uint64_t secondaryMisses; // Block cache misses that went back to the file
+    uint64_t demotedBlocks;   // Blocks evicted from the block cache into the secondary tier
+    uint64_t demotedBytes;    // Their decompressed size...
+    uint64_t packedBytes;     // ...and what they were packed down to
+    uint64_t hintHits;        // Lookups answered from a location hint
+    uint64_t hintMisses;      // Lookups that had no usable hint and searched the tables
+};
+
+class SecondaryBlockCache;
+class LocationHints;
+
+struct BedrockDB {
+    std::filesystem::path dir;
+    std::string snapshotPath;
+    // Declared before current so that the table sets, and with them every CacheSlot, go first.
+    std::unique_ptr<leveldb::Cache> tableCache; // CacheSlot::id -> OpenTable*, capacity = max open tables
+    std::unique_ptr<SecondaryBlockCache> secondaryCache; // Outlives blockCache, which demotes into it even while being destroyed
+    std::unique_ptr<leveldb::Cache> blockCache; // (CacheSlot::id, offset) -> CachedBlock*, charged by decompressed size
+    std::unique_ptr<LocationHints> hints; // Null unless options.locationHints > 0
+    std::atomic<uint64_t> retiredTables = 0;
+    std::atomic<uint64_t> closedRetiredTables = 0;
+    std::atomic<std::shared_ptr<const TableSet>> current;
+    std::mutex updateMutex; // Serializes UpdateDB; guards manifest
+    ManifestState manifest;
+    DBOptions options;
     leveldb::ReadOptions readOptions;
+    std::future<void> prefetchTask; // Background Prefetch/PrefetchChunkRect, at most one at a time
+};
+
+// Platform layer: read-only file handles and whole-file mappings.
+
+#ifdef _WIN32
+using NativeFile = HANDLE;
+static const NativeFile kNoFile = INVALID_HANDLE_VALUE;
+#else
+using NativeFile = int;
+constexpr NativeFile kNoFile = -1;
+#endif
+
+// Random for tables, which are sought into; Sequential for logs, which are scanned front to back.
+enum class FileAccess { Random, Sequential };
+
+struct FileView {
+    uint8_t* data = nullptr;
+    uint64_t size = 0;
+#ifdef _WIN32
+    HANDLE section = NULL;
+#endif
 };
 
+struct MemoryRange {
+    void* address;
+    size_t bytes;
+};
+
+// Library-wide huge page use, set through SetHugePages. Transparent asks the kernel to back file
+// mappings and large buffers with 2 MB pages where it can; Explicit additionally takes the buffers
+// from the reserved huge page pool. File mappings can only ever get transparent ones.
+enum HugePageMode : int32_t { kHugePagesOff = 0, kHugePagesTransparent = 1, kHugePagesExplicit = 2 };
+constexpr size_t kHugePageSize = size_t(2) << 20;
+static std::atomic<int32_t> g_hugePages = kHugePagesOff;
+
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+// Reserves an inaccessible range of bytes starting on a huge page boundary, for a MAP_FIXED mapping
+// to take over; an unaligned mapping can't use a huge page for its first and last partial 2 MB.
+static void* ReserveHugeAligned(size_t bytes) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    bytes = (bytes + page - 1) / page * page;
+    void* p = mmap(nullptr, bytes + kHugePageSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+    uintptr_t start = reinterpret_cast<uintptr_t>(p);
+    uintptr_t aligned = (start + kHugePageSize - 1) & ~uintptr_t(kHugePageSize - 1);
+    if (aligned > start) munmap(p, aligned - start);
+    if (size_t tail = start + kHugePageSize - aligned) munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    return reinterpret_cast<void*>(aligned);
+}
+#endif
+
+static NativeFile OpenReadOnlyFile(const std::string& path, FileAccess access) {
+#ifdef _WIN32
+    // Tables get FILE_SHARE_DELETE so compaction in the game can still remove them while we hold them.
+    if (access == FileAccess::Random)
+        return CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    return CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) posix_fadvise(fd, 0, 0, access == FileAccess::Random ? POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL);
+    return fd;
+#endif
+}
+
+static void CloseNativeFile(NativeFile& file) {
+    if (file == kNoFile) return;
+#ifdef _WIN32
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+    file = kNoFile;
+}
+
+static bool NativeFileSize(NativeFile file, uint64_t& size) {
+#ifdef _WIN32
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(file, &sz)) return false;
+    size = static_cast<uint64_t>(sz.QuadPart);
+#else
+    struct stat st;
+    if (fstat(file, &st) != 0) return false;
+    size = static_cast<uint64_t>(st.st_size);
+#endif
+    return true;
+}
+
+static void UnmapFile(FileView& view) {
+#ifdef _WIN32
+    if (view.data) UnmapViewOfFile(view.data);
+    if (view.section) CloseHandle(view.section);
+    view.section = NULL;
+#else
+    if (view.data) munmap(view.data, view.size);
+#endif
+    view.data = nullptr;
+    view.size = 0;
+}
+
+// Maps the first size bytes of file read-only, replacing whatever view held. On Linux an existing
+// view is resized with mremap, which grows it in place when the address space after it is free,
+// so a growing log isn't torn down and faulted in again on every refresh.
+static bool MapFile(NativeFile file, uint64_t size, FileAccess access, FileView& view) {
+    if (size == 0) { UnmapFile(view); return false; }
+#ifdef _WIN32
+    UnmapFile(view);
+    view.section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!view.section) return false;
+    view.data = (uint8_t*)MapViewOfFile(view.section, FILE_MAP_READ, 0, 0, 0);
+    if (!view.data) { UnmapFile(view); return false; }
+#else
+    void* p = MAP_FAILED;
+#ifdef __linux__
+    if (view.data) p = mremap(view.data, view.size, size, MREMAP_MAYMOVE);
+#endif
+#ifdef MADV_HUGEPAGE
+    bool huge = g_hugePages.load(std::memory_order_relaxed) != kHugePagesOff;
+#else
+    constexpr bool huge = false;
+#endif
+    if (p == MAP_FAILED) {
+        UnmapFile(view);
+        void* at = nullptr;
+#ifdef MADV_HUGEPAGE
+        if (huge && size >= kHugePageSize) at = ReserveHugeAligned(size);
+#endif
+        p = mmap(at, size, PROT_READ, MAP_SHARED | (at ? MAP_FIXED : 0), file, 0);
+        if (p == MAP_FAILED) { if (at) munmap(at, size); return false; }
+    }
+    view.data = (uint8_t*)p;
+    madvise(p, size, access == FileAccess::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+    // Only takes effect where the kernel supports huge pages for read-only file mappings.
+#ifdef MADV_HUGEPAGE
+    if (huge) madvise(p, size, MADV_HUGEPAGE);
+#endif
+#endif
+    view.size = size;
+    return true;
+}
+
+// Asks the OS to fault the given (page-aligned) ranges of mapped files in, without waiting for them.
+// Windows takes the whole list in one PrefetchVirtualMemory call; elsewhere every range is its own
+// madvise(MADV_WILLNEED), one syscall per range, each of which queues the reads and returns.
+static void PrefetchMemory(const std::vector<MemoryRange>& ranges) {
+#ifdef _WIN32
+    std::vector<WIN32_MEMORY_RANGE_ENTRY> entries(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) entries[i] = { ranges[i].address, ranges[i].bytes };
+    PrefetchVirtualMemory(GetCurrentProcess(), entries.size(), entries.data(), 0);
+#else
+    for (auto const& r : ranges) madvise(r.address, r.bytes, MADV_WILLNEED);
+#endif
+}
+
+// Zeroed read-write memory for large, randomly accessed buffers, on huge pages when g_hugePages
+// allows and they are available, on normal pages otherwise.
+struct PageBuffer {
+    void* data = nullptr;
+    size_t bytes = 0;
+};
+
+static PageBuffer AllocatePageBuffer(size_t bytes) {
+    PageBuffer buf;
+    int32_t mode = g_hugePages.load(std::memory_order_relaxed);
+#ifdef _WIN32
+    if (mode == kHugePagesExplicit) {
+        if (size_t large = GetLargePageMinimum()) {
+            size_t rounded = (bytes + large - 1) / large * large;
+            buf.data = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (buf.data) { buf.bytes = rounded; return buf; }
+        }
+    }
+    buf.data = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (buf.data) buf.bytes = bytes;
+#else
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (mode == kHugePagesExplicit) {
+        size_t rounded = (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+#ifdef MAP_HUGE_2MB
+        p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+#else
+        p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (p != MAP_FAILED) bytes = rounded;
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if (p == MAP_FAILED && mode != kHugePagesOff && bytes >= kHugePageSize) {
+        if (void* at = ReserveHugeAligned(bytes)) {
+            p = mmap(at, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+            if (p != MAP_FAILED) madvise(p, bytes, MADV_HUGEPAGE);
+            else munmap(at, bytes);
+        }
+    }
+#endif
+    if (p == MAP_FAILED) p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) { buf.data = p; buf.bytes = bytes; }
+#endif
+    return buf;
+}
+
+static void FreePageBuffer(PageBuffer& buf) {
+    if (!buf.data) return;
+#ifdef _WIN32
+    VirtualFree(buf.data, 0, MEM_RELEASE);
+#else
+    munmap(buf.data, buf.bytes);
+#endif
+    buf = {};
+}
+
+// The mode that SetHugePages(requested) can actually deliver on this machine and process.
+static int32_t AvailableHugePages(int32_t requested) {
+    if (requested <= kHugePagesOff) return kHugePagesOff;
+#ifdef _WIN32
+    // Large pages need SeLockMemoryPrivilege granted to the user and enabled on the token. There is
+    // nothing transparent to fall back to.
+    if (requested < kHugePagesExplicit || !GetLargePageMinimum()) return kHugePagesOff;
+    HANDLE token;
+    if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        TOKEN_PRIVILEGES tp = {};
+        tp.PrivilegeCount = 1;
+        tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &tp.Privileges[0].Luid))
+            AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr);
+        CloseHandle(token);
+    }
+    size_t large = GetLargePageMinimum();
+    void* probe = VirtualAlloc(nullptr, large, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (!probe) return kHugePagesOff;
+    VirtualFree(probe, 0, MEM_RELEASE);
+    return kHugePagesExplicit;
+#elif defined(__linux__)
+#ifdef MAP_HUGETLB
+    if (requested >= kHugePagesExplicit) {
+        // Fails straight away when no huge pages are reserved (vm.nr_hugepages).
+        void* probe = mmap(nullptr, kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (probe != MAP_FAILED) { munmap(probe, kHugePageSize); return kHugePagesExplicit; }
+    }
+#endif
+    std::ifstream thp("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string setting;
+    if (!std::getline(thp, setting) || setting.find("[never]") != std::string::npos) return kHugePagesOff;
+    return kHugePagesTransparent;
+#else
+    return kHugePagesOff;
+#endif
+}
+
 struct MappedLog {
     std::string path;
-    uint64_t mappedSize = 0;
-    uint8_t* data = nullptr;
-    HANDLE hFile = INVALID_HANDLE_VALUE;
-    HANDLE hMap = NULL;
+    NativeFile file = kNoFile;
+    FileView view;
 };
 
 struct LogSession {
     std::vector<std::unique_ptr<MappedLog>> logs;
+    bool verifyChecksums = false; // Matches only count inside complete records with a valid crc
+};
+
+// Instrumentation
+//
+// Every thread bumps its own counters and histograms with plain relaxed stores (one writer each, no
+// locked instructions), and GetStats sums them. Threads register on first use and fold their
+// totals into the registry when they exit, so the short-lived ParallelFor workers aren't lost.
+
+enum StatCounter : int {
+    kStatKeysLookedUp, kStatTablesProbed, kStatTablesSkipped, kStatTableCacheHits, kStatTableCacheMisses,
+    kStatBlocksRead, kStatBlockBytesRead, kStatBytesCopied, kStatSessionKeys, kStatKeysIterated,
+    kStatCounterCount
+};
+enum StatTimer : int {
+    kTimerOpenDB, kTimerUpdateDB, kTimerUpdateLogSession, kTimerBatchLookup, kTimerSessionLookup, kTimerIterate, kTimerParallelFor,
+    kTimerCount
+};
+
+// Log-linear buckets, 4 per power of two from 2^8 ns; the first and last also catch everything
+// below and above (256 ns .. ~4.3 s).
+constexpr int kHistogramBuckets = 96;
+constexpr int kHistogramMinShift = 8;
+
+// Mirrors LevelDBMinimal.LatencyHistogram.
+struct LatencyHistogram {
+    uint64_t count;
+    uint64_t totalNanos;
+    uint64_t maxNanos;
+    uint64_t buckets[kHistogramBuckets];
+};
+
+// Mirrors LevelDBMinimal.DBStats; only ever append fields.
+struct DBStats {
+    uint64_t counters[kStatCounterCount];
+    LatencyHistogram timers[kTimerCount];
+};
+
+struct ThreadStats {
+    struct Histogram { std::atomic<uint64_t> count, totalNanos, maxNanos, buckets[kHistogramBuckets]; };
+    std::atomic<uint64_t> counters[kStatCounterCount] = {};
+    Histogram timers[kTimerCount] = {};
+};
+
+struct StatsRegistry {
+    std::mutex mutex;
+    std::vector<ThreadStats*> live;
+    DBStats retired{};  // Totals of exited threads
+    DBStats baseline{}; // Totals at the last ResetStats
+};
+
+// Never destroyed: thread exits during process teardown still fold into it.
+static StatsRegistry& Registry() {
+    static StatsRegistry* registry = new StatsRegistry();
+    return *registry;
+}
+
+static void AddThreadStats(const ThreadStats& t, DBStats& out) {
+    for (int i = 0; i < kStatCounterCount; ++i) out.counters[i] += t.counters[i].load(std::memory_order_relaxed);
+    for (int i = 0; i < kTimerCount; ++i) {
+        const auto& h = t.timers[i];
+        auto& o = out.timers[i];
+        o.count += h.count.load(std::memory_order_relaxed);
+        o.totalNanos += h.totalNanos.load(std::memory_order_relaxed);
+        o.maxNanos = std::max(o.maxNanos, h.maxNanos.load(std::memory_order_relaxed));
+        for (int b = 0; b < kHistogramBuckets; ++b) o.buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+    }
+}
+
+struct ThreadStatsSlot {
+    ThreadStats stats;
+    ThreadStatsSlot() {
+        auto& r = Registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.live.push_back(&stats);
+    }
+    ~ThreadStatsSlot() {
+        auto& r = Registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        AddThreadStats(stats, r.retired);
+        r.live.erase(std::find(r.live.begin(), r.live.end(), &stats));
+    }
+};
+
+static ThreadStats& LocalStats() {
+    thread_local ThreadStatsSlot slot;
+    return slot.stats;
+}
+
+static inline void Bump(std::atomic<uint64_t>& c, uint64_t n) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static inline void CountStat(StatCounter counter, uint64_t n = 1) {
+    Bump(LocalStats().counters[counter], n);
+}
+
+static inline int HistogramBucket(uint64_t nanos) {
+    if (nanos < (1ull << kHistogramMinShift)) return 0;
+    int shift = (int)std::bit_width(nanos) - 1;
+    int bucket = (shift - kHistogramMinShift) * 4 + (int)((nanos >> (shift - 2)) & 3);
+    return std::min(bucket, kHistogramBuckets - 1);
+}
+
+static void RecordLatency(StatTimer timer, uint64_t nanos) {
+    auto& h = LocalStats().timers[timer];
+    Bump(h.count, 1);
+    Bump(h.totalNanos, nanos);
+    if (nanos > h.maxNanos.load(std::memory_order_relaxed)) h.maxNanos.store(nanos, std::memory_order_relaxed);
+    Bump(h.buckets[HistogramBucket(nanos)], 1);
+}
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(StatTimer timer) : timer_(timer), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        RecordLatency(timer_, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    StatTimer timer_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Tracing
+//
+// Optional span tracing. While enabled, each span is appended to a ring owned by the calling thread
+// (one writer, no locks), and DumpTrace writes every ring out as Chrome trace-event JSON for
+// chrome://tracing or Perfetto. Off by default; a span costs one relaxed load while it's off.
+
+constexpr size_t kTraceRingEvents = 8192;
+
+struct TraceEvent {
+    const char* name; // Always a string literal
+    uint64_t startNanos;
+    uint64_t durNanos;
+    uint32_t tid;
+};
+
+struct TraceRing {
+    TraceEvent events[kTraceRingEvents];
+    std::atomic<uint64_t> head = 0; // Events ever written; the newest kTraceRingEvents are kept
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings; // Every ring handed out so far
+    std::vector<TraceRing*> idle;                  // Rings of exited threads, reused by new ones
+    std::atomic<bool> enabled = false;
+    std::atomic<uint64_t> floorNanos = 0;          // Events that started earlier were cleared
+    uint32_t nextTid = 1;
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+// Never destroyed, like the stats registry.
+static TraceRegistry& Tracer() {
+    static TraceRegistry* tracer = new TraceRegistry();
+    return *tracer;
+}
+
+struct ThreadTrace {
+    TraceRing* ring = nullptr; // Taken on the first span this thread records
+    uint32_t tid = 0;
+    ~ThreadTrace() {
+        if (!ring) return;
+        auto& r = Tracer();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.idle.push_back(ring);
+    }
+};
+
+static inline bool TraceEnabled() {
+    return Tracer().enabled.load(std::memory_order_relaxed);
+}
+
+static inline uint64_t TraceNow() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Tracer().epoch).count();
+}
+
+static void EmitSpan(const char* name, uint64_t startNanos, uint64_t endNanos) {
+    thread_local ThreadTrace local;
+    if (!local.ring) {
+        auto& r = Tracer();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.idle.empty()) { local.ring = r.idle.back(); r.idle.pop_back(); }
+        else { r.rings.push_back(std::make_unique<TraceRing>()); local.ring = r.rings.back().get(); }
+        local.tid = r.nextTid++;
+    }
+    uint64_t h = local.ring->head.load(std::memory_order_relaxed);
+    local.ring->events[h % kTraceRingEvents] = { name, startNanos, endNanos - startNanos, local.tid };
+    local.ring->head.store(h + 1, std::memory_order_release);
+}
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name_(TraceEnabled() ? name : nullptr), start_(name_ ? TraceNow() : 0) {}
+    ~TraceSpan() { if (name_) EmitSpan(name_, start_, TraceNow()); }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+// Call recording
+//
+// Optional log of every exported call the host makes, with its arguments, start time and duration,
+// for replaying a field session offline with leveldbminimal_replay. Calls the library makes to
+// itself (StartTracker opening its db, the tracker refreshing) aren't logged; the tracker logs one
+// kRecTrackerQuery per position it answers instead. Handles are logged as small ids, numbered the
+// first time the recorder sees them. Off by default; a call costs one relaxed load while it's off.
+//   header: magic "LDBMREC1" | uint32 version | uint32 reserved
+//   record: uint8 op | varint thread | varint start micros since StartRecording | varint duration
+//           nanos | varint status (zigzag) | op fields (varint ids and ints, length-prefixed bytes)
+// The op fields of every op are listed in tools/replay.cpp. Records follow in completion order.
+
+constexpr char kRecordMagic[8] = { 'L', 'D', 'B', 'M', 'R', 'E', 'C', '1' };
+constexpr uint32_t kRecordVersion = 7;
+constexpr size_t kRecordFlushBytes = 1 << 20;
+
+enum RecordOp : uint8_t {
+    kRecOpenDB = 1, kRecUpdateDB, kRecCloseDB, kRecIterateDB, kRecBatchGetFlat, kRecBatchGetStreaming, kRecPrefetch,
+    kRecPrefetchChunkRect, kRecOpenLogSession, kRecUpdateLogSession, kRecCloseLogSession, kRecBatchGetSessionFlat,
+    kRecCreateResultRing, kRecDestroyResultRing, kRecQueryChunkBoxes, kRecStartTracker, kRecSetPosition,
+    kRecTrackerQuery, kRecStopTracker,
+};
+
+struct CallRecorder {
+    std::mutex mutex; // Guards everything below
+    FILE* file = nullptr;
+    std::string buffer;
+    std::unordered_map<const void*, uint64_t> ids;
+    uint64_t nextId = 1;
+    uint64_t session = 0; // Bumped by StartRecording, so calls begun under an older one are dropped
+    std::chrono::steady_clock::time_point epoch;
+    std::atomic<bool> active = false;
+    std::atomic<uint32_t> nextThread = 0;
+};
+
+// Never destroyed, like the stats registry.
+static CallRecorder& Recorder() {
+    static CallRecorder* recorder = new CallRecorder();
+    return *recorder;
+}
+
+static thread_local int32_t t_callDepth = 0;
+
+// Marks calls this thread makes into the exports as the library's own, which aren't recorded.
+struct InternalCalls {
+    InternalCalls() { ++t_callDepth; }
+    ~InternalCalls() { --t_callDepth; }
+    InternalCalls(const InternalCalls&) = delete;
+    InternalCalls& operator=(const InternalCalls&) = delete;
+};
+
+static inline void PutVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) { out.push_back(char(v | 0x80)); v >>= 7; }
+    out.push_back(char(v));
+}
+
+static inline uint64_t ZigZag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+
+static uint64_t RecordId(CallRecorder& r, const void* handle) {
+    if (!handle) return 0;
+    auto [it, added] = r.ids.try_emplace(handle, r.nextId);
+    if (added) r.nextId++;
+    return it->second;
+}
+
+static void FlushRecording(CallRecorder& r) {
+    if (r.file && !r.buffer.empty()) fwrite(r.buffer.data(), 1, r.buffer.size(), r.file);
+    r.buffer.clear();
+}
+
+// Builds one record over the lifetime of an exported call and appends it when the call returns.
+// Status defaults to kStatusInvalid, so the early outs on bad arguments need no extra code.
+class CallRecord {
+public:
+    explicit CallRecord(RecordOp op) : active_(t_callDepth++ == 0 && Recorder().active.load(std::memory_order_relaxed)), op_(op) {
+        if (!active_) return;
+        start_ = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(Recorder().mutex);
+        session_ = Recorder().session;
+    }
+    ~CallRecord() {
+        t_callDepth--;
+        if (active_) Append();
+    }
+    CallRecord(const CallRecord&) = delete;
+    CallRecord& operator=(const CallRecord&) = delete;
+
+    void Handle(const void* handle) {
+        if (!active_) return;
+        handles_.push_back(fields_.size());
+        handlePtrs_.push_back(handle);
+    }
+    void Int(int64_t v) { if (active_) PutVarint(fields_, ZigZag(v)); }
+    void Bytes(const void* p, size_t n) {
+        if (!active_) return;
+        PutVarint(fields_, n);
+        if (n) fields_.append(reinterpret_cast<const char*>(p), n);
+    }
+    void Str(const char* s) { Bytes(s, s ? strlen(s) : 0); }
+    void Keys(const uint8_t* flatKeys, const int32_t* keyOffsets, const int32_t* keyLengths, int32_t count) {
+        if (!active_) return;
+        if (!flatKeys || !keyOffsets || !keyLengths) count = 0;
+        PutVarint(fields_, (uint64_t)std::max(count, 0));
+        for (int32_t i = 0; i < count; ++i) Bytes(flatKeys + keyOffsets[i], (size_t)keyLengths[i]);
+    }
+
+    template <typename T>
+    T Return(T result) { status_ = (int64_t)result; return result; }
+    // For the calls that hand out a handle; its id is appended after the op fields.
+    template <typename T>
+    T* Created(T* handle) { created_ = handle; status_ = handle ? 0 : -1; return handle; }
+    void Released(const void* handle) { released_ = handle; status_ = 0; }
+
+private:
+    void Append() {
+        auto end = std::chrono::steady_clock::now();
+        thread_local uint32_t thread = Recorder().nextThread.fetch_add(1, std::memory_order_relaxed);
+        auto& r = Recorder();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (r.file && r.session == session_) Write(r, thread, end);
+        if (released_) r.ids.erase(released_);
+    }
+
+    void Write(CallRecorder& r, uint32_t thread, std::chrono::steady_clock::time_point end) {
+        std::string& out = r.buffer;
+        out.push_back(char(op_));
+        PutVarint(out, thread);
+        PutVarint(out, (uint64_t)std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(start_ - r.epoch).count()));
+        PutVarint(out, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count());
+        PutVarint(out, ZigZag(status_));
+        size_t copied = 0;
+        for (size_t i = 0; i < handles_.size(); ++i) {
+            out.append(fields_, copied, handles_[i] - copied);
+            copied = handles_[i];
+            PutVarint(out, RecordId(r, handlePtrs_[i]));
+        }
+        out.append(fields_, copied);
+        if (op_ == kRecOpenDB || op_ == kRecOpenLogSession || op_ == kRecCreateResultRing || op_ == kRecStartTracker)
+            PutVarint(out, RecordId(r, created_));
+        if (out.size() >= kRecordFlushBytes) FlushRecording(r);
+    }
+
+    bool active_;
+    RecordOp op_;
+    int64_t status_ = -1;
+    const void* created_ = nullptr;
+    const void* released_ = nullptr;
+    uint64_t session_ = 0;
+    std::chrono::steady_clock::time_point start_;
+    std::string fields_;
+    std::vector<size_t> handles_; // Field offsets where a handle id goes, resolved under the lock
+    std::vector<const void*> handlePtrs_;
 };
 
+// Splits [start, end) into one contiguous range per worker and calls f(rangeStart, rangeEnd).
 template <typename Index, typename Func>
-void ParallelFor(Index start, Index end, Func&& f) {
+void ParallelForRanges(Index start, Index end, Func&& f) {
     auto count = end - start;
     if (count <= 0) return;
+    ScopedTimer timer(kTimerParallelFor);
     if (g_threadCount == 0) {
         g_threadCount = std::thread::hardware_concurrency();
         if (g_threadCount == 0) g_threadCount = 2;
     }
 
     if (count < 32) {
-        for (Index i = start; i < end; ++i) f(i);
+        f(start, end);
         return;
     }
 
@@ -72,14 +844,48 @@ void ParallelFor(Index start, Index end, Func&& f) {
     for (unsigned int t = 0; t < g_threadCount; ++t) {
         Index tStart = start + t * blockSize;
         Index tEnd = (t == g_threadCount - 1) ? end : tStart + blockSize;
-        futures.emplace_back(std::async(std::launch::async, [tStart, tEnd, &f]() {
-            for (Index i = tStart; i < tEnd; ++i) f(i);
-            }));
+        futures.emplace_back(std::async(std::launch::async, [tStart, tEnd, &f]() { f(tStart, tEnd); }));
     }
 
     for (auto& fut : futures) fut.wait();
 }
 
+template <typename Index, typename Func>
+void ParallelFor(Index start, Index end, Func&& f) {
+    ParallelForRanges(start, end, [&f](Index tStart, Index tEnd) {
+        for (Index i = tStart; i < tEnd; ++i) f(i);
+        });
+}
+
+// Status returned by the long-running exports. Anything but kStatusOk besides kStatusInvalid means
+// the call stopped early and its results are partial: keys it never reached are reported missing.
+enum CallStatus : int32_t { kStatusInvalid = -1, kStatusOk = 0, kStatusCancelled = 1, kStatusDeadline = 2 };
+
+// Cooperative stop condition for one long-running call: a host-owned flag that becomes non-zero to
+// cancel, and/or a deadline. Workers poll it between units of work (a lookup round, a key, a few
+// dozen merged keys) and bail out, so a stop takes effect within one unit.
+struct StopToken {
+    int32_t* cancel = nullptr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    mutable std::atomic<int32_t> status = kStatusOk;
+
+    StopToken() = default;
+    StopToken(int32_t* cancelFlag, int64_t deadlineMicros) : cancel(cancelFlag) {
+        if (deadlineMicros > 0) deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(deadlineMicros);
+    }
+
+    bool Stopped() const {
+        if (status.load(std::memory_order_relaxed) != kStatusOk) return true;
+        int32_t why = kStatusOk;
+        if (cancel && std::atomic_ref<int32_t>(*cancel).load(std::memory_order_relaxed) != 0) why = kStatusCancelled;
+        else if (deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline) why = kStatusDeadline;
+        if (why == kStatusOk) return false;
+        int32_t expected = kStatusOk;
+        status.compare_exchange_strong(expected, why, std::memory_order_relaxed);
+        return true;
+    }
+};
+
 static inline uint32_t ReadVarint32(const uint8_t* p, size_t& consumed) {
     uint32_t result = 0;
     uint8_t b = *p++; consumed = 1;
@@ -90,381 +896,3013 @@ static inline uint32_t ReadVarint32(const uint8_t* p, size_t& consumed) {
     b = *p++; consumed++; result |= (b & 0x7F) << 28; return result;
 }
 
-static std::unique_ptr<SSTable> LoadTable(const std::string& fullPath) {
-    leveldb::Env* env = leveldb::Env::Default();
-    leveldb::RandomAccessFile* file = nullptr;
-    if (!env->NewRandomAccessFile(fullPath, &file).ok()) return nullptr;
+static inline bool GetVarint64(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift <= 63 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        value |= uint64_t(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static inline bool GetLengthPrefixed(const uint8_t*& p, const uint8_t* end, std::string_view& out) {
+    uint64_t len;
+    if (!GetVarint64(p, end, len) || len > uint64_t(end - p)) return false;
+    out = std::string_view(reinterpret_cast<const char*>(p), (size_t)len);
+    p += len;
+    return true;
+}
+
+// leveldb log framing (MANIFEST and .log files): 32 KiB blocks of records, each with a
+// checksum(4) length(2) type(1) header. Large records are split into FIRST/MIDDLE/LAST fragments.
+constexpr uint64_t kLogBlockSize = 32768;
+constexpr uint64_t kLogHeaderSize = 7;
+enum LogRecordType : uint8_t { kZeroType = 0, kFullType = 1, kFirstType = 2, kMiddleType = 3, kLastType = 4 };
+
+// CRC32C (Castagnoli), which leveldb stores masked in block trailers and log record headers. With
+// the SSE4.2 / ARMv8 crc32c instruction, long inputs run as three independent streams to hide its
+// latency, stitched together with precomputed zero-extension tables (after Mark Adler's crc32c.c).
+// CPUs without it fall back to a byte-wise table.
+
+constexpr uint32_t kCrc32cPoly = 0x82f63b78; // Reflected
+constexpr uint32_t kCrcMaskDelta = 0xa282ead8;
+constexpr size_t kCrcLong = 8192;  // Stream length of the long interleaved loop
+constexpr size_t kCrcShort = 256;  // and of the short one
+
+struct Crc32cTables {
+    uint32_t bytes[256];
+    uint32_t longShift[4][256];  // Extends a crc by kCrcLong zero bytes
+    uint32_t shortShift[4][256]; // Extends a crc by kCrcShort zero bytes
+    bool hardware = false;
+};
+
+static uint32_t Gf2MatrixTimes(const uint32_t* mat, uint32_t vec) {
+    uint32_t sum = 0;
+    for (; vec; vec >>= 1, ++mat) if (vec & 1) sum ^= *mat;
+    return sum;
+}
+
+static void Gf2MatrixSquare(uint32_t* square, const uint32_t* mat) {
+    for (int n = 0; n < 32; ++n) square[n] = Gf2MatrixTimes(mat, mat[n]);
+}
+
+// The operator that runs len zero bytes (a power of two) through the crc register.
+static void CrcZerosOperator(uint32_t* even, size_t len) {
+    uint32_t odd[32];
+    odd[0] = kCrc32cPoly;
+    for (int n = 1; n < 32; ++n) odd[n] = 1u << (n - 1);
+    Gf2MatrixSquare(even, odd); // 2 zero bits
+    Gf2MatrixSquare(odd, even); // 4 zero bits
+    while (true) {
+        Gf2MatrixSquare(even, odd);
+        if ((len >>= 1) == 0) return;
+        Gf2MatrixSquare(odd, even);
+        if ((len >>= 1) == 0) break;
+    }
+    memcpy(even, odd, sizeof(odd));
+}
+
+static void FillShiftTable(uint32_t table[4][256], size_t len) {
+    uint32_t op[32];
+    CrcZerosOperator(op, len);
+    for (uint32_t n = 0; n < 256; ++n) {
+        for (int b = 0; b < 4; ++b) table[b][n] = Gf2MatrixTimes(op, n << (8 * b));
+    }
+}
+
+static inline uint32_t CrcShift(const uint32_t table[4][256], uint32_t crc) {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+static bool CpuHasCrc32c() {
+#if defined(_M_X64)
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] & (1 << 20)) != 0;
+#elif defined(__x86_64__)
+    return __builtin_cpu_supports("sse4.2");
+#elif defined(__aarch64__) && defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+
+static const Crc32cTables& CrcTables() {
+    static const std::unique_ptr<Crc32cTables> tables = [] {
+        auto t = std::make_unique<Crc32cTables>();
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t crc = n;
+            for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (kCrc32cPoly & (0u - (crc & 1)));
+            t->bytes[n] = crc;
+        }
+        FillShiftTable(t->longShift, kCrcLong);
+        FillShiftTable(t->shortShift, kCrcShort);
+        t->hardware = CpuHasCrc32c();
+        return t;
+    }();
+    return *tables;
+}
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__aarch64__)
+#if defined(__x86_64__)
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#elif defined(__aarch64__) && defined(__clang__)
+#define CRC32C_TARGET __attribute__((target("crc")))
+#elif defined(__aarch64__)
+#define CRC32C_TARGET __attribute__((target("+crc")))
+#else
+#define CRC32C_TARGET
+#endif
+
+static CRC32C_TARGET inline uint32_t Crc32cWord(uint32_t crc, const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#ifdef __aarch64__
+    return __crc32cd(crc, v);
+#else
+    return static_cast<uint32_t>(_mm_crc32_u64(crc, v));
+#endif
+}
+
+static CRC32C_TARGET inline uint32_t Crc32cByte(uint32_t crc, uint8_t v) {
+#ifdef __aarch64__
+    return __crc32cb(crc, v);
+#else
+    return _mm_crc32_u8(crc, v);
+#endif
+}
+
+// Runs three consecutive streams of len bytes each and folds them into crc.
+static CRC32C_TARGET uint32_t Crc32cTriple(uint32_t crc0, const uint8_t* p, size_t len, const uint32_t shift[4][256]) {
+    uint32_t crc1 = 0, crc2 = 0;
+    for (const uint8_t* end = p + len; p < end; p += 8) {
+        crc0 = Crc32cWord(crc0, p);
+        crc1 = Crc32cWord(crc1, p + len);
+        crc2 = Crc32cWord(crc2, p + 2 * len);
+    }
+    crc0 = CrcShift(shift, crc0) ^ crc1;
+    return CrcShift(shift, crc0) ^ crc2;
+}
+
+static CRC32C_TARGET uint32_t Crc32cHardware(const Crc32cTables& t, const uint8_t* p, size_t n) {
+    uint32_t crc = 0xffffffff;
+    for (; n && (reinterpret_cast<uintptr_t>(p) & 7); --n) crc = Crc32cByte(crc, *p++);
+    for (; n >= 3 * kCrcLong; p += 3 * kCrcLong, n -= 3 * kCrcLong) crc = Crc32cTriple(crc, p, kCrcLong, t.longShift);
+    for (; n >= 3 * kCrcShort; p += 3 * kCrcShort, n -= 3 * kCrcShort) crc = Crc32cTriple(crc, p, kCrcShort, t.shortShift);
+    for (; n >= 8; p += 8, n -= 8) crc = Crc32cWord(crc, p);
+    for (; n; --n) crc = Crc32cByte(crc, *p++);
+    return ~crc;
+}
+#endif
+
+static uint32_t Crc32c(const uint8_t* p, size_t n) {
+    const Crc32cTables& t = CrcTables();
+#ifdef CRC32C_TARGET
+    if (t.hardware) return Crc32cHardware(t, p, n);
+#endif
+    uint32_t crc = 0xffffffff;
+    for (; n; --n) crc = t.bytes[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+// leveldb masks stored crcs so that a crc of data that itself contains crcs stays well distributed.
+static inline bool MaskedCrcMatches(const uint8_t* stored, const uint8_t* p, size_t n) {
+    uint32_t masked;
+    memcpy(&masked, stored, sizeof(masked));
+    uint32_t rot = masked - kCrcMaskDelta;
+    return ((rot >> 17) | (rot << 15)) == Crc32c(p, n);
+}
+
+// True when every log record fragment overlapping [begin, end) is complete and matches its crc,
+// which rules out records the game is still writing. begin has to fall inside a payload.
+static bool LogSpanIntact(const uint8_t* data, uint64_t size, uint64_t begin, uint64_t end) {
+    bool started = false;
+    for (uint64_t pos = begin - begin % kLogBlockSize; pos < end;) {
+        uint64_t leftInBlock = kLogBlockSize - pos % kLogBlockSize;
+        if (leftInBlock < kLogHeaderSize) {
+            if (!started) return false;
+            pos += leftInBlock;
+            continue;
+        }
+        if (pos + kLogHeaderSize > size) return false;
+        const uint8_t* h = data + pos;
+        uint64_t len = h[4] | (uint64_t(h[5]) << 8);
+        uint64_t payload = pos + kLogHeaderSize;
+        if (kLogHeaderSize + len > leftInBlock || payload + len > size) return false;
+        if (payload + len > begin) {
+            if (!started && begin < payload) return false;
+            if (!MaskedCrcMatches(h, h + 6, len + 1)) return false; // Covers the type byte and the payload
+            started = true;
+        }
+        pos = payload + len;
+    }
+    return started;
+}
+
+// Calls onRecord for every complete logical record in data, where data[0] sits at file offset
+// base. Returns the file offset just past the last complete record, i.e. where to resume once
+// the writer has appended more.
+template <typename Func>
+static uint64_t ReadLogRecords(const uint8_t* data, uint64_t size, uint64_t base, Func&& onRecord) {
+    const uint64_t end = base + size;
+    uint64_t pos = base, resume = base;
+    std::string fragments;
+    bool inFragment = false;
+
+    while (true) {
+        uint64_t leftInBlock = kLogBlockSize - pos % kLogBlockSize;
+        if (leftInBlock < kLogHeaderSize) { pos += leftInBlock; continue; } // Zero-filled block trailer
+        if (pos + kLogHeaderSize > end) break;
+
+        const uint8_t* h = data + (pos - base);
+        uint32_t len = h[4] | (uint32_t(h[5]) << 8);
+        uint8_t type = h[6];
+        if (type == kZeroType || kLogHeaderSize + len > leftInBlock || pos + kLogHeaderSize + len > end) break;
+
+        std::string_view payload(reinterpret_cast<const char*>(h + kLogHeaderSize), len);
+        pos += kLogHeaderSize + len;
+        switch (type) {
+        case kFullType: onRecord(payload); inFragment = false; resume = pos; break;
+        case kFirstType: fragments.assign(payload); inFragment = true; break;
+        case kMiddleType: if (inFragment) fragments.append(payload); break;
+        case kLastType:
+            if (inFragment) { fragments.append(payload); onRecord(std::string_view(fragments)); }
+            inFragment = false; resume = pos;
+            break;
+        default: return resume;
+        }
+    }
+    return resume;
+}
+
+// Applies one VersionEdit (leveldb version_edit.cc) to the live file set.
+static bool ApplyVersionEdit(std::string_view record, ManifestState& state) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(record.data());
+    const uint8_t* end = p + record.size();
+    while (p < end) {
+        uint64_t tag, level, number, size;
+        std::string_view smallest, largest;
+        if (!GetVarint64(p, end, tag)) return false;
+        switch (tag) {
+        case 1: // Comparator
+            if (!GetLengthPrefixed(p, end, smallest)) return false;
+            break;
+        case 2: case 3: case 4: case 9: // Log number, next file number, last sequence, prev log number
+            if (!GetVarint64(p, end, number)) return false;
+            break;
+        case 5: // Compact pointer
+            if (!GetVarint64(p, end, level) || !GetLengthPrefixed(p, end, smallest)) return false;
+            break;
+        case 6: // Deleted file
+            if (!GetVarint64(p, end, level) || !GetVarint64(p, end, number)) return false;
+            state.files.erase(number);
+            break;
+        case 7: { // New file
+            if (!GetVarint64(p, end, level) || !GetVarint64(p, end, number) || !GetVarint64(p, end, size) ||
+                !GetLengthPrefixed(p, end, smallest) || !GetLengthPrefixed(p, end, largest)) return false;
+            if (smallest.size() < 8 || largest.size() < 8) return false;
+            auto& entry = state.files[number];
+            entry.level = (int)level;
+            entry.smallest.assign(smallest.substr(0, smallest.size() - 8));
+            entry.largest.assign(largest.substr(0, largest.size() - 8));
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+// Brings state up to date with the MANIFEST in dir. On any parse problem the state is marked
+// invalid and callers fall back to treating every .ldb as live with an unknown key range.
+static void RefreshManifest(const std::filesystem::path& dir, ManifestState& state) {
+    TraceSpan span("refresh manifest");
+    std::string name;
+    {
+        std::ifstream current(dir / "CURRENT");
+        if (!current || !std::getline(current, name)) { state = {}; return; }
+        if (!name.empty() && name.back() == '\r') name.pop_back();
+    }
+    if (name != state.name) { state = {}; state.name = name; }
+    if (state.corrupt) return;
+
+    std::ifstream in(dir / name, std::ios::binary | std::ios::ate);
+    if (!in) { state.valid = false; return; }
+    uint64_t size = static_cast<uint64_t>(in.tellg());
+    if (size < state.offset) { state = {}; state.name = name; }
+    if (size == state.offset) return;
+
+    std::vector<uint8_t> buf(size - state.offset);
+    in.seekg(state.offset);
+    if (!in.read(reinterpret_cast<char*>(buf.data()), buf.size())) { state.valid = false; return; }
+
+    bool ok = true;
+    state.offset = ReadLogRecords(buf.data(), buf.size(), state.offset, [&](std::string_view record) {
+        if (ok && !ApplyVersionEdit(record, state)) ok = false;
+        });
+    state.corrupt = !ok;
+    state.valid = ok && !state.files.empty();
+}
+
+// Metadata sidecar: the replayed MANIFEST state plus the size and mtime of every live table when
+// it was written. Fixed-size records followed by a key blob, so it can be read or mapped as is.
+//   SnapshotHeader | manifest name (padded to 8) | SnapshotTable[tableCount] | key blob
+constexpr char kSnapshotMagic[8] = { 'L', 'D', 'B', 'M', 'S', 'N', 'A', 'P' };
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr uint64_t kManifestHeadHashBytes = 4096;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tableCount;
+    uint64_t manifestOffset;
+    uint64_t manifestHeadHash; // Guards against a different db that reuses the MANIFEST name
+    uint32_t manifestNameLen;
+    uint32_t reserved;
+    uint64_t blobSize;
+};
+
+struct SnapshotTable {
+    uint64_t number;
+    uint64_t fileSize; // 0 when the file was already gone
+    int64_t mtime;
+    int32_t level;
+    uint32_t smallestLen;
+    uint32_t largestLen;
+    uint32_t reserved;
+    uint64_t keysOffset; // Smallest then largest, in the key blob
+};
+
+static_assert(sizeof(SnapshotHeader) == 48 && sizeof(SnapshotTable) == 48, "snapshot layout is persistent");
+
+static uint64_t HashManifestHead(const std::filesystem::path& file, uint64_t limit) {
+    std::ifstream in(file, std::ios::binary);
+    std::vector<char> buf((size_t)std::min(limit, kManifestHeadHashBytes));
+    if (!in.read(buf.data(), buf.size())) return 0;
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (char c : buf) { h ^= (uint8_t)c; h *= 1099511628211ull; }
+    return h;
+}
+
+static bool StatTable(const std::filesystem::path& file, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = static_cast<uint64_t>(std::filesystem::file_size(file, ec));
+    if (ec) return false;
+    mtime = std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+    return !ec;
+}
+
+static std::filesystem::path TableFileName(const std::filesystem::path& dir, uint64_t number) {
+    char name[32];
+    snprintf(name, sizeof(name), "%06llu.ldb", (unsigned long long)number);
+    return dir / name;
+}
+
+// Seeds state from the sidecar when it still describes dir: same MANIFEST, same head, and every
+// table that is still on disk unchanged. RefreshManifest then only replays the newer edits.
+static bool LoadMetadataSnapshot(const std::string& snapshotPath, const std::filesystem::path& dir, ManifestState& state) {
+    std::ifstream in(snapshotPath, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    std::vector<char> buf(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(buf.data(), buf.size()) || buf.size() < sizeof(SnapshotHeader)) return false;
+
+    SnapshotHeader hdr;
+    memcpy(&hdr, buf.data(), sizeof(hdr));
+    if (memcmp(hdr.magic, kSnapshotMagic, sizeof(hdr.magic)) != 0 || hdr.version != kSnapshotVersion) return false;
+    size_t tablesAt = sizeof(hdr) + ((hdr.manifestNameLen + 7) & ~size_t(7));
+    size_t blobAt = tablesAt + (size_t)hdr.tableCount * sizeof(SnapshotTable);
+    if (blobAt > buf.size() || hdr.blobSize > buf.size() - blobAt) return false;
+
+    std::string name(buf.data() + sizeof(hdr), hdr.manifestNameLen);
+    std::string current;
+    {
+        std::ifstream cur(dir / "CURRENT");
+        if (!cur || !std::getline(cur, current)) return false;
+        if (!current.empty() && current.back() == '\r') current.pop_back();
+    }
+    if (name != current) return false;
+    std::error_code ec;
+    uint64_t manifestSize = static_cast<uint64_t>(std::filesystem::file_size(dir / name, ec));
+    if (ec || manifestSize < hdr.manifestOffset) return false;
+    if (HashManifestHead(dir / name, hdr.manifestOffset) != hdr.manifestHeadHash) return false;
+
+    ManifestState loaded;
+    loaded.name = name;
+    loaded.offset = hdr.manifestOffset;
+    const char* blob = buf.data() + blobAt;
+    for (uint32_t i = 0; i < hdr.tableCount; ++i) {
+        SnapshotTable rec;
+        memcpy(&rec, buf.data() + tablesAt + i * sizeof(SnapshotTable), sizeof(rec));
+        if (rec.keysOffset > hdr.blobSize || uint64_t(rec.smallestLen) + rec.largestLen > hdr.blobSize - rec.keysOffset) return false;
+        if (rec.fileSize != 0) {
+            uint64_t size; int64_t mtime;
+            if (StatTable(TableFileName(dir, rec.number), size, mtime) && (size != rec.fileSize || mtime != rec.mtime)) return false;
+        }
+        auto& entry = loaded.files[rec.number];
+        entry.level = rec.level;
+        entry.smallest.assign(blob + rec.keysOffset, rec.smallestLen);
+        entry.largest.assign(blob + rec.keysOffset + rec.smallestLen, rec.largestLen);
+    }
+    loaded.valid = !loaded.files.empty();
+    state = std::move(loaded);
+    return true;
+}
+
+static void SaveMetadataSnapshot(const std::string& snapshotPath, const std::filesystem::path& dir, const ManifestState& state) {
+    if (!state.valid || state.corrupt) return;
+
+    SnapshotHeader hdr{};
+    memcpy(hdr.magic, kSnapshotMagic, sizeof(hdr.magic));
+    hdr.version = kSnapshotVersion;
+    hdr.tableCount = (uint32_t)state.files.size();
+    hdr.manifestOffset = state.offset;
+    hdr.manifestHeadHash = HashManifestHead(dir / state.name, state.offset);
+    hdr.manifestNameLen = (uint32_t)state.name.size();
+
+    std::vector<SnapshotTable> recs;
+    std::string blob;
+    recs.reserve(state.files.size());
+    for (auto const& [number, entry] : state.files) {
+        SnapshotTable rec{};
+        rec.number = number;
+        rec.level = entry.level;
+        if (!StatTable(TableFileName(dir, number), rec.fileSize, rec.mtime)) { rec.fileSize = 0; rec.mtime = 0; }
+        rec.smallestLen = (uint32_t)entry.smallest.size();
+        rec.largestLen = (uint32_t)entry.largest.size();
+        rec.keysOffset = blob.size();
+        blob += entry.smallest; blob += entry.largest;
+        recs.push_back(rec);
+    }
+    hdr.blobSize = blob.size();
+
+    // Write next to the target and rename over it so a crash never leaves a torn sidecar.
+    std::string tmpPath = snapshotPath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) return;
+        static const char zeros[8] = {};
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(state.name.data(), state.name.size());
+        out.write(zeros, ((state.name.size() + 7) & ~size_t(7)) - state.name.size());
+        out.write(reinterpret_cast<const char*>(recs.data()), recs.size() * sizeof(SnapshotTable));
+        out.write(blob.data(), blob.size());
+        if (!out) return;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, snapshotPath, ec);
+}
+
+static bool ParseTableNumber(const std::filesystem::path& file, uint64_t& number) {
+    std::string stem = file.stem().string();
+    auto [ptr, err] = std::from_chars(stem.data(), stem.data() + stem.size(), number);
+    return err == std::errc() && ptr == stem.data() + stem.size();
+}
+
+// Creates the metadata entry for a table file, or returns null if the MANIFEST says the file is
+// not live: either it is obsolete after a compaction or its version edit is not written yet, and
+// in the latter case its contents are still in the .log.
+static std::unique_ptr<SSTable> RegisterTable(BedrockDB* db, const std::string& fullPath, uint64_t size) {
+    auto t = std::make_unique<SSTable>();
+    t->path = fullPath; t->fileSize = size;
+    bool numbered = ParseTableNumber(fullPath, t->number);
+    if (db->manifest.valid) {
+        auto it = numbered ? db->manifest.files.find(t->number) : db->manifest.files.end();
+        if (it == db->manifest.files.end()) return nullptr;
+        t->level = it->second.level;
+        t->hasRange = true;
+        t->smallest = it->second.smallest;
+        t->largest = it->second.largest;
+    }
+    t->slot = std::make_shared<CacheSlot>(db->tableCache.get(), &db->closedRetiredTables);
+    return t;
+}
+
+// Lookup order: level 0 newest file first, then the deeper levels. Without a MANIFEST every
+// table is level 0, which degrades to newest file first.
+static void SortTables(TableSet& set) {
+    std::stable_sort(set.tables.begin(), set.tables.end(), [](auto const& a, auto const& b) {
+        if (a->level != b->level) return a->level < b->level;
+        return a->number > b->number;
+        });
+    set.pathIndex.clear();
+    for (size_t i = 0; i < set.tables.size(); ++i) set.pathIndex.emplace(set.tables[i]->path, i);
+}
+
+template <typename KeyOps>
+static inline bool TableMayContain(const SSTable& t, std::string_view key) {
+    return !t.hasRange || (KeyOps::Compare(key, t.smallest) >= 0 && KeyOps::Compare(key, t.largest) <= 0);
+}
+
+static inline bool TableMayContainPrefix(const SSTable& t, std::string_view prefix) {
+    if (!t.hasRange || prefix.empty()) return true;
+    return std::string_view(t.largest) >= prefix && std::string_view(t.smallest).substr(0, prefix.size()) <= prefix;
+}
+
+// Raw deflate (RFC 1951), the format of Bedrock's kZlibRawCompression blocks. Single-shot: the
+// whole stream is decoded into one caller-supplied buffer, with two-level Huffman tables, a 64-bit
+// bit buffer refilled a word at a time and matches copied eight bytes at a time. The tables live in
+// a per-thread InflateState, so decoding a block allocates nothing but its output.
+
+constexpr int kLitLenRootBits = 10;
+constexpr int kDistRootBits = 8;
+constexpr int kPrecodeRootBits = 7;
+constexpr int kMaxCodeLength = 15;
+constexpr size_t kLitLenTableSize = 2048; // 1444 is the most a valid code needs with a 10-bit root
+constexpr size_t kDistTableSize = 1024;
+constexpr size_t kPrecodeTableSize = 128;
+
+// Table entry: value(16) extra(8) kind(3) bits(5). A subtable entry's value is the subtable's start
+// and its extra the subtable's index width; bits is always what the entry's own level consumes.
+enum InflateEntryKind : uint32_t { kEntryInvalid = 0, kEntryLiteral = 1, kEntryBase = 2, kEntryEnd = 3, kEntrySubtable = 4 };
+
+constexpr uint32_t MakeInflateEntry(uint32_t kind, uint32_t value, uint32_t extra) { return (value << 16) | (extra << 8) | (kind << 5); }
+static inline uint32_t EntryKind(uint32_t e) { return (e >> 5) & 7; }
+static inline uint32_t EntryValue(uint32_t e) { return e >> 16; }
+static inline uint32_t EntryExtra(uint32_t e) { return (e >> 8) & 0xff; }
+
+struct InflateSymbols {
+    uint32_t litLen[288];
+    uint32_t dist[32];
+    uint32_t precode[19];
+
+    InflateSymbols() {
+        static constexpr uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static constexpr uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static constexpr uint16_t kDistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static constexpr uint8_t kDistExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        for (uint32_t s = 0; s < 288; ++s) {
+            if (s < 256) litLen[s] = MakeInflateEntry(kEntryLiteral, s, 0);
+            else if (s == 256) litLen[s] = MakeInflateEntry(kEntryEnd, 0, 0);
+            else if (s < 286) litLen[s] = MakeInflateEntry(kEntryBase, kLengthBase[s - 257], kLengthExtra[s - 257]);
+            else litLen[s] = MakeInflateEntry(kEntryInvalid, 0, 0);
+        }
+        for (uint32_t s = 0; s < 32; ++s) dist[s] = s < 30 ? MakeInflateEntry(kEntryBase, kDistBase[s], kDistExtra[s]) : MakeInflateEntry(kEntryInvalid, 0, 0);
+        for (uint32_t s = 0; s < 19; ++s) precode[s] = MakeInflateEntry(kEntryLiteral, s, 0);
+    }
+};
+
+static const InflateSymbols& Symbols() {
+    static const InflateSymbols symbols;
+    return symbols;
+}
+
+// Builds the decode table for a canonical Huffman code given its code lengths. Incomplete codes are
+// allowed (their unused entries stay invalid and fail when hit); over-subscribed ones are not.
+static bool BuildDecodeTable(const uint8_t* lengths, uint32_t count, int rootBits, const uint32_t* symbols, uint32_t* table, size_t capacity) {
+    uint16_t lengthCount[kMaxCodeLength + 1] = {};
+    for (uint32_t s = 0; s < count; ++s) lengthCount[lengths[s]]++;
+    lengthCount[0] = 0;
+    int left = 1;
+    for (int len = 1; len <= kMaxCodeLength; ++len) {
+        left = (left << 1) - lengthCount[len];
+        if (left < 0) return false;
+    }
+    uint16_t nextCode[kMaxCodeLength + 1] = {};
+    for (int len = 1, code = 0; len <= kMaxCodeLength; ++len) {
+        code = (code + lengthCount[len - 1]) << 1;
+        nextCode[len] = (uint16_t)code;
+    }
+
+    const uint32_t rootSize = 1u << rootBits;
+    std::fill(table, table + rootSize, 0u);
+    uint8_t subtableBits[1 << kLitLenRootBits] = {};
+    uint16_t reversed[288];
+    for (uint32_t s = 0; s < count; ++s) {
+        int len = lengths[s];
+        if (!len) continue;
+        uint32_t code = nextCode[len]++, rev = 0;
+        for (int i = 0; i < len; ++i) rev |= ((code >> i) & 1) << (len - 1 - i); // Deflate sends codes msb first
+        reversed[s] = (uint16_t)rev;
+        if (len <= rootBits) {
+            for (uint32_t i = rev; i < rootSize; i += 1u << len) table[i] = symbols[s] | uint32_t(len);
+        }
+        else {
+            uint8_t& bits = subtableBits[rev & (rootSize - 1)];
+            bits = std::max<uint8_t>(bits, uint8_t(len - rootBits));
+        }
+    }
+
+    size_t used = rootSize;
+    for (uint32_t prefix = 0; prefix < rootSize; ++prefix) {
+        if (!subtableBits[prefix]) continue;
+        size_t size = size_t(1) << subtableBits[prefix];
+        if (used + size > capacity) return false;
+        std::fill(table + used, table + used + size, 0u);
+        table[prefix] = MakeInflateEntry(kEntrySubtable, (uint32_t)used, subtableBits[prefix]) | uint32_t(rootBits);
+        used += size;
+    }
+    for (uint32_t s = 0; s < count; ++s) {
+        int len = lengths[s];
+        if (len <= rootBits) continue;
+        uint32_t root = table[reversed[s] & (rootSize - 1)];
+        uint32_t start = EntryValue(root), size = 1u << EntryExtra(root);
+        for (uint32_t i = reversed[s] >> rootBits; i < size; i += 1u << (len - rootBits)) table[start + i] = symbols[s] | uint32_t(len - rootBits);
+    }
+    return true;
+}
+
+struct InflateState {
+    uint32_t litLen[kLitLenTableSize];
+    uint32_t dist[kDistTableSize];
+    uint32_t precode[kPrecodeTableSize];
+    uint32_t fixedLitLen[kLitLenTableSize];
+    uint32_t fixedDist[kDistTableSize];
+    std::unique_ptr<uint8_t[]> output; // Inflate target, kept at the largest block seen so far
+    size_t outputCapacity = 0;
+
+    InflateState() {
+        uint8_t lengths[288 + 32];
+        std::fill(lengths, lengths + 144, uint8_t(8));
+        std::fill(lengths + 144, lengths + 256, uint8_t(9));
+        std::fill(lengths + 256, lengths + 280, uint8_t(7));
+        std::fill(lengths + 280, lengths + 288, uint8_t(8));
+        std::fill(lengths + 288, lengths + 320, uint8_t(5));
+        BuildDecodeTable(lengths, 288, kLitLenRootBits, Symbols().litLen, fixedLitLen, kLitLenTableSize);
+        BuildDecodeTable(lengths + 288, 32, kDistRootBits, Symbols().dist, fixedDist, kDistTableSize);
+    }
+};
+
+static InflateState& ThreadInflateState() {
+    thread_local std::unique_ptr<InflateState> state = std::make_unique<InflateState>();
+    return *state;
+}
+
+enum class InflateResult { Ok, ShortOutput, Corrupt };
+
+// Decodes a complete raw deflate stream into out[0, capacity), setting written on success.
+static InflateResult InflateRaw(InflateState& st, const uint8_t* in, size_t inLen, uint8_t* out, size_t capacity, size_t& written) {
+    const uint8_t* const inEnd = in + inLen;
+    uint8_t* const outStart = out;
+    uint8_t* const outEnd = out + capacity;
+    uint64_t bitbuf = 0;
+    uint32_t bitsLeft = 0;
+    uint32_t overrun = 0; // Zero bytes fed in past the end of the input
+
+    // Tops the buffer up to at least 56 bits. A word load may leave the next byte's low bits above
+    // bitsLeft; the next load ORs the same byte into the same place, so that is harmless.
+    auto refill = [&]() {
+        if (inEnd - in >= 8) {
+            uint64_t word;
+            memcpy(&word, in, sizeof(word));
+            bitbuf |= word << bitsLeft;
+            in += (63 - bitsLeft) >> 3;
+            bitsLeft |= 56;
+        }
+        else {
+            for (; bitsLeft <= 56; bitsLeft += 8) {
+                if (in < inEnd) bitbuf |= uint64_t(*in++) << bitsLeft;
+                else overrun++;
+            }
+        }
+    };
+    auto take = [&](uint32_t n) {
+        uint32_t v = uint32_t(bitbuf & ((uint64_t(1) << n) - 1));
+        bitbuf >>= n;
+        bitsLeft -= n;
+        return v;
+    };
+    auto decode = [&](const uint32_t* table, int rootBits) {
+        uint32_t e = table[bitbuf & ((1u << rootBits) - 1)];
+        if (EntryKind(e) == kEntrySubtable) {
+            take(rootBits);
+            e = table[EntryValue(e) + (bitbuf & ((1u << EntryExtra(e)) - 1))];
+        }
+        take(e & 31);
+        return e;
+    };
+
+    bool last = false;
+    while (!last) {
+        refill();
+        if (overrun > 8) return InflateResult::Corrupt;
+        last = take(1) != 0;
+        uint32_t type = take(2);
+
+        if (type == 0) {
+            // Stored: back up to the first unconsumed whole byte and copy straight from the input.
+            take(bitsLeft & 7);
+            if (overrun * 8 > bitsLeft) return InflateResult::Corrupt;
+            in -= bitsLeft / 8 - overrun;
+            bitbuf = 0; bitsLeft = 0; overrun = 0;
+            if (inEnd - in < 4) return InflateResult::Corrupt;
+            uint32_t len = in[0] | (uint32_t(in[1]) << 8), nlen = in[2] | (uint32_t(in[3]) << 8);
+            in += 4;
+            if ((len ^ 0xffff) != nlen || size_t(inEnd - in) < len) return InflateResult::Corrupt;
+            if (size_t(outEnd - out) < len) return InflateResult::ShortOutput;
+            memcpy(out, in, len);
+            in += len; out += len;
+            continue;
+        }
+
+        const uint32_t* litLen = st.fixedLitLen;
+        const uint32_t* dist = st.fixedDist;
+        if (type == 2) {
+            uint32_t hlit = take(5) + 257, hdist = take(5) + 1, hclen = take(4) + 4;
+            static constexpr uint8_t kPrecodeOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+            uint8_t precodeLengths[19] = {};
+            for (uint32_t i = 0; i < hclen; ++i) {
+                refill();
+                precodeLengths[kPrecodeOrder[i]] = (uint8_t)take(3);
+            }
+            if (hlit > 286 || hdist > 30 || !BuildDecodeTable(precodeLengths, 19, kPrecodeRootBits, Symbols().precode, st.precode, kPrecodeTableSize))
+                return InflateResult::Corrupt;
+
+            uint8_t lengths[286 + 30];
+            for (uint32_t i = 0; i < hlit + hdist;) {
+                refill();
+                if (overrun > 8) return InflateResult::Corrupt;
+                uint32_t e = decode(st.precode, kPrecodeRootBits);
+                if (EntryKind(e) != kEntryLiteral) return InflateResult::Corrupt;
+                uint32_t sym = EntryValue(e), repeat;
+                uint8_t value = 0;
+                if (sym < 16) { lengths[i++] = (uint8_t)sym; continue; }
+                if (sym == 16) {
+                    if (i == 0) return InflateResult::Corrupt;
+                    value = lengths[i - 1];
+                    repeat = 3 + take(2);
+                }
+                else if (sym == 17) repeat = 3 + take(3);
+                else repeat = 11 + take(7);
+                if (i + repeat > hlit + hdist) return InflateResult::Corrupt;
+                std::fill(lengths + i, lengths + i + repeat, value);
+                i += repeat;
+            }
+            if (!lengths[256] ||
+                !BuildDecodeTable(lengths, hlit, kLitLenRootBits, Symbols().litLen, st.litLen, kLitLenTableSize) ||
+                !BuildDecodeTable(lengths + hlit, hdist, kDistRootBits, Symbols().dist, st.dist, kDistTableSize))
+                return InflateResult::Corrupt;
+            litLen = st.litLen;
+            dist = st.dist;
+        }
+        else if (type != 1) {
+            return InflateResult::Corrupt;
+        }
+
+        while (true) {
+            // 56 bits cover the longest length/distance pair: 15 + 5 + 15 + 13.
+            refill();
+            if (overrun > 8) return InflateResult::Corrupt;
+            uint32_t e = decode(litLen, kLitLenRootBits);
+            uint32_t kind = EntryKind(e);
+            if (kind == kEntryLiteral) {
+                if (out == outEnd) return InflateResult::ShortOutput;
+                *out++ = (uint8_t)EntryValue(e);
+                continue;
+            }
+            if (kind == kEntryEnd) break;
+            if (kind != kEntryBase) return InflateResult::Corrupt;
+            size_t length = EntryValue(e) + take(EntryExtra(e));
+
+            e = decode(dist, kDistRootBits);
+            if (EntryKind(e) != kEntryBase) return InflateResult::Corrupt;
+            size_t distance = EntryValue(e) + take(EntryExtra(e));
+            if (distance > size_t(out - outStart)) return InflateResult::Corrupt;
+            if (length > size_t(outEnd - out)) return InflateResult::ShortOutput;
+
+            const uint8_t* src = out - distance;
+            uint8_t* end = out + length;
+            if (distance >= 8 && size_t(outEnd - end) >= 8) {
+                // Every 8-byte load reads only bytes that are already written; the last store may
+                // run up to 7 bytes past end, which the next symbol overwrites.
+                for (; out < end; out += 8, src += 8) {
+                    uint64_t word;
+                    memcpy(&word, src, sizeof(word));
+                    memcpy(out, &word, sizeof(word));
+                }
+            }
+            else if (distance == 1) {
+                memset(out, *src, length);
+            }
+            else {
+                for (uint8_t* p = out; p < end; ++p, ++src) *p = *src;
+            }
+            out = end;
+        }
+    }
+    if (overrun * 8 > bitsLeft) return InflateResult::Corrupt;
+    written = size_t(out - outStart);
+    return InflateResult::Ok;
+}
+
+// leveldb reads a block as its contents plus a type(1) crc(4) trailer, all in one Read. The only other
+// read is the footer at the very end of the file, which carries no crc.
+constexpr size_t kBlockTrailerSize = 5;
+constexpr size_t kTableFooterSize = 48;
+
+static bool BlockReadIntact(uint64_t offset, const leveldb::Slice& data, uint64_t fileSize) {
+    if (data.size() <= kBlockTrailerSize || (data.size() == kTableFooterSize && offset + kTableFooterSize == fileSize)) return true;
+    auto p = reinterpret_cast<const uint8_t*>(data.data());
+    return MaskedCrcMatches(p + data.size() - 4, p, data.size() - 4);
+}
+
+// Native block reads for point lookups. leveldb decompresses every block it reads into a fresh
+// buffer and gives no say in how; these reads go through the mapping instead, decode compressed
+// blocks once into a buffer owned by BedrockDB::blockCache, and leave uncompressed ones in place.
+// Iteration and anything this path can't decode (snappy, zstd without LEVELDBMINIMAL_WITH_ZSTD,
+// unmapped files) still take leveldb's route.
+
+constexpr uint64_t kTableMagic = 0xdb4775248b80fb57ull;
+constexpr size_t kMaxBlockBytes = 64 << 20; // Anything claiming to inflate past this is corrupt
+
+struct BlockHandle {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+static inline uint32_t LoadLE32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static bool DecodeBlockHandle(const uint8_t*& p, const uint8_t* end, BlockHandle& h) {
+    return GetVarint64(p, end, h.offset) && GetVarint64(p, end, h.size);
+}
+
+static bool InitBlockView(const uint8_t* data, size_t size, BlockView& view) {
+    if (size < 4 || size > UINT32_MAX) return false;
+    uint32_t restarts = LoadLE32(data + size - 4);
+    if (restarts == 0 || restarts > (size - 4) / 4) return false;
+    view.data = data;
+    view.numRestarts = restarts;
+    view.restartsOffset = uint32_t(size - 4 - 4 * size_t(restarts));
+    return true;
+}
+
+// Walks the entries of one block, the way leveldb's Block::Iter does.
+class BlockIter {
+public:
+    explicit BlockIter(const BlockView& block) : b_(block) {}
+
+    // Positions at the first entry whose key is >= target, comparing bytewise.
+    bool Seek(std::string_view target) {
+        uint32_t left = 0, right = b_.numRestarts - 1;
+        while (left < right) {
+            uint32_t mid = (left + right + 1) / 2;
+            key_.clear();
+            if (!ParseAt(Restart(mid))) return false;
+            if (std::string_view(key_) < target) left = mid;
+            else right = mid - 1;
+        }
+        key_.clear();
+        for (bool ok = ParseAt(Restart(left)); ok; ok = Next()) {
+            if (std::string_view(key_) >= target) return true;
+        }
+        return false;
+    }
+
+    bool Next() { return next_ < b_.restartsOffset && ParseAt(next_); }
+
+    bool Corrupt() const { return corrupt_; }
+    std::string_view key() const { return key_; }
+    std::string_view value() const { return value_; }
+    uint32_t offset() const { return offset_; }
+
+private:
+    uint32_t Restart(uint32_t i) const { return LoadLE32(b_.data + b_.restartsOffset + 4 * size_t(i)); }
+
+    // Decodes the entry at offset on top of the previous key.
+    bool ParseAt(uint32_t offset) {
+        const uint8_t* p = b_.data + offset;
+        const uint8_t* limit = b_.data + b_.restartsOffset;
+        uint64_t shared, nonShared, valueLen;
+        if (offset >= b_.restartsOffset || !GetVarint64(p, limit, shared) || !GetVarint64(p, limit, nonShared) || !GetVarint64(p, limit, valueLen) ||
+            shared > key_.size() || nonShared + valueLen > uint64_t(limit - p)) {
+            corrupt_ = true;
+            return false;
+        }
+        key_.resize((size_t)shared);
+        key_.append(reinterpret_cast<const char*>(p), (size_t)nonShared);
+        value_ = std::string_view(reinterpret_cast<const char*>(p + nonShared), (size_t)valueLen);
+        offset_ = offset;
+        next_ = uint32_t(p + nonShared + valueLen - b_.data);
+        return true;
+    }
+
+    const BlockView& b_;
+    std::string key_;
+    std::string_view value_;
+    uint32_t offset_ = 0;
+    uint32_t next_ = 0;
+    bool corrupt_ = false;
+};
+
+enum class BlockStatus { Ok, Unsupported, Corrupt };
+
+// Copies the first size bytes of a decode buffer into one of exactly that size, so a cached block
+// never holds on to (or is charged for) the slack of its decode buffer.
+static void CopyOutBlock(const uint8_t* decoded, size_t size, std::unique_ptr<uint8_t[]>& out) {
+    auto copy = std::make_unique_for_overwrite<uint8_t[]>(std::max<size_t>(size, 1));
+    memcpy(copy.get(), decoded, size);
+    out = std::move(copy);
+}
+
+// Decompresses a block of the given leveldb compression type into a buffer of its own; size is
+// what the buffer holds, charge what it costs.
+static BlockStatus DecompressBlock(uint8_t type, const uint8_t* raw, size_t rawSize, std::unique_ptr<uint8_t[]>& out, size_t& size, size_t& charge) {
+    if (type == leveldb::kZlibRawCompression) {
+        InflateState& st = ThreadInflateState();
+        size_t capacity = std::max<size_t>({ st.outputCapacity, rawSize * 4, 4096 });
+        while (capacity <= kMaxBlockBytes) {
+            if (capacity > st.outputCapacity) {
+                st.output = std::make_unique_for_overwrite<uint8_t[]>(capacity);
+                st.outputCapacity = capacity;
+            }
+            switch (InflateRaw(st, raw, rawSize, st.output.get(), capacity, size)) {
+            case InflateResult::Ok:
+                CopyOutBlock(st.output.get(), size, out);
+                charge = size;
+                return BlockStatus::Ok;
+            case InflateResult::ShortOutput: capacity *= 2; break;
+            case InflateResult::Corrupt: return BlockStatus::Corrupt;
+            }
+        }
+        // Don't let a block that only claimed to be huge pin its buffer for the life of the thread.
+        st.output.reset();
+        st.outputCapacity = 0;
+        return BlockStatus::Corrupt;
+    }
+#ifdef LEVELDBMINIMAL_WITH_ZSTD
+    if (type == leveldb::kZstdCompression) {
+        thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        unsigned long long content = ZSTD_getFrameContentSize(raw, rawSize);
+        if (content == ZSTD_CONTENTSIZE_ERROR || (content != ZSTD_CONTENTSIZE_UNKNOWN && content > kMaxBlockBytes)) return BlockStatus::Corrupt;
+        size_t capacity = content == ZSTD_CONTENTSIZE_UNKNOWN ? std::max<size_t>(rawSize * 4, 4096) : std::max<size_t>((size_t)content, 1);
+        while (capacity <= kMaxBlockBytes) {
+            out = std::make_unique_for_overwrite<uint8_t[]>(capacity);
+            size = ZSTD_decompressDCtx(dctx.get(), out.get(), capacity, raw, rawSize);
+            if (!ZSTD_isError(size)) {
+                if (size < capacity) CopyOutBlock(out.get(), size, out);
+                charge = size;
+                return BlockStatus::Ok;
+            }
+            if (ZSTD_getErrorCode(size) != ZSTD_error_dstSize_tooSmall) return BlockStatus::Corrupt;
+            capacity *= 2;
+        }
+        return BlockStatus::Corrupt;
+    }
+#endif
+    return BlockStatus::Unsupported;
+}
+
+// LZ4 block format, for the secondary block cache. Greedy single-probe matching against a 4K-entry
+// hash table that skips ahead faster the longer it goes without a match: blocks are packed each
+// time they drop out of the block cache, so speed matters more here than ratio.
+
+constexpr int kLz4HashBits = 12;
+constexpr size_t kLz4MinMatch = 4;
+constexpr size_t kLz4LastLiterals = 5;    // Every block ends with at least this many literals...
+constexpr size_t kLz4MatchFindLimit = 12; // ...and no match starts closer than this to the end
+constexpr size_t kLz4MaxOffset = 65535;
+
+static inline uint32_t Lz4Hash(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - kLz4HashBits);
+}
+
+static inline uint8_t* Lz4PutLength(uint8_t* op, size_t len) {
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// Packs src[0, n) into dst[0, capacity). Returns the packed size, or 0 if it doesn't fit.
+static size_t Lz4Compress(const uint8_t* src, size_t n, uint8_t* dst, size_t capacity) {
+    uint32_t table[1 << kLz4HashBits] = {};
+    const uint8_t* const end = src + n;
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    uint8_t* op = dst;
+    uint8_t* const opEnd = dst + capacity;
+
+    // One sequence: the literals since anchor, then the match (none for the last sequence).
+    auto emit = [&](size_t literals, size_t matchLen, size_t offset) {
+        size_t need = 1 + literals / 255 + 1 + literals + (matchLen ? 2 + matchLen / 255 + 1 : 0);
+        if (need > size_t(opEnd - op)) return false;
+        uint8_t* token = op++;
+        *token = uint8_t(std::min<size_t>(literals, 15) << 4);
+        if (literals >= 15) op = Lz4PutLength(op, literals - 15);
+        memcpy(op, anchor, literals);
+        op += literals;
+        if (matchLen) {
+            op[0] = uint8_t(offset);
+            op[1] = uint8_t(offset >> 8);
+            op += 2;
+            size_t extra = matchLen - kLz4MinMatch;
+            *token |= uint8_t(std::min<size_t>(extra, 15));
+            if (extra >= 15) op = Lz4PutLength(op, extra - 15);
+        }
+        return true;
+    };
+
+    if (n > kLz4MatchFindLimit) {
+        const uint8_t* const matchLimit = end - kLz4LastLiterals;
+        const uint8_t* const findLimit = end - kLz4MatchFindLimit;
+        while (ip <= findLimit) {
+            uint32_t h = Lz4Hash(ip);
+            const uint8_t* ref = src + table[h];
+            table[h] = uint32_t(ip - src);
+            if (ref >= ip || size_t(ip - ref) > kLz4MaxOffset || memcmp(ref, ip, kLz4MinMatch) != 0) {
+                ip += 1 + (size_t(ip - anchor) >> 6);
+                continue;
+            }
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) { --ip; --ref; }
+            size_t len = kLz4MinMatch;
+            for (;;) {
+                if (ip + len + 8 > matchLimit) {
+                    while (ip + len < matchLimit && ip[len] == ref[len]) ++len;
+                    break;
+                }
+                uint64_t x, y;
+                memcpy(&x, ip + len, 8);
+                memcpy(&y, ref + len, 8);
+                if (x != y) { len += std::countr_zero(x ^ y) >> 3; break; }
+                len += 8;
+            }
+            if (!emit(size_t(ip - anchor), len, size_t(ip - ref))) return 0;
+            ip += len;
+            anchor = ip;
+            table[Lz4Hash(ip - 2)] = uint32_t(ip - 2 - src);
+        }
+    }
+    if (!emit(size_t(end - anchor), 0, 0)) return 0;
+    return size_t(op - dst);
+}
+
+// Unpacks an LZ4 block into exactly size bytes at dst. Checks every length and offset, so a damaged
+// block fails instead of reading or writing out of bounds.
+static bool Lz4Decompress(const uint8_t* src, size_t n, uint8_t* dst, size_t size) {
+    const uint8_t* ip = src;
+    const uint8_t* const ipEnd = src + n;
+    uint8_t* op = dst;
+    uint8_t* const opEnd = dst + size;
+    auto length = [&](size_t& len) {
+        uint8_t b;
+        do {
+            if (ip == ipEnd) return false;
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+        return true;
+    };
+    while (ip < ipEnd) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !length(literals)) return false;
+        if (literals > size_t(ipEnd - ip) || literals > size_t(opEnd - op)) return false;
+        // Short runs, the common case, are copied as a fixed 16 bytes when both sides have room.
+        if (literals <= 16 && ipEnd - ip >= 16 && opEnd - op >= 16) memcpy(op, ip, 16);
+        else memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == ipEnd) break;
+
+        if (ipEnd - ip < 2) return false;
+        size_t offset = ip[0] | size_t(ip[1]) << 8;
+        ip += 2;
+        size_t len = token & 15;
+        if (len == 15 && !length(len)) return false;
+        len += kLz4MinMatch;
+        if (offset == 0 || offset > size_t(op - dst) || len > size_t(opEnd - op)) return false;
+        const uint8_t* from = op - offset;
+        if (offset >= 8 && size_t(opEnd - op) >= std::max<size_t>(len + 8, 16)) {
+            memcpy(op, from, 8);
+            memcpy(op + 8, from + 8, 8);
+            for (size_t i = 16; i < len; i += 8) memcpy(op + i, from + i, 8);
+        } else {
+            for (size_t i = 0; i < len; ++i) op[i] = from[i];
+        }
+        op += len;
+    }
+    return op == opEnd;
+}
+
+// A decompressed block held in BedrockDB::blockCache.
+struct CachedBlock {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size = 0;
+    SecondaryBlockCache* demoteTo = nullptr; // Where the block goes once the block cache lets it go
+};
+
+// Second tier under BedrockDB::blockCache. Blocks the block cache evicts are packed with LZ4 and
+// kept here under the same key; a block cache miss that hits here unpacks the block and promotes
+// it back, which is far cheaper than going to the file and inflating it again. Packed blocks take
+// a fraction of the space, so the same memory keeps several times more of the world warm.
+class SecondaryBlockCache {
+public:
+    explicit SecondaryBlockCache(size_t capacity) : cache_(leveldb::NewLRUCache(capacity)) {}
+
+    // Called from the block cache's deleter, under its shard lock, so this only queues the block.
+    void Demote(const leveldb::Slice& key, std::unique_ptr<uint8_t[]> data, size_t size) {
+        std::lock_guard lock(pendingMutex_);
+        pending_.push_back({ std::string(key.data(), key.size()), std::move(data), size });
+        hasPending_.store(true, std::memory_order_release);
+    }
+
+    // Packs and stores what Demote queued. Readers call it after inserting into blockCache, outside
+    // its locks; the insert is what evicts. A block blockCache still holds was replaced by a racing
+    // miss on the same block rather than evicted, so it is dropped instead of stored twice.
+    void DrainDemoted(leveldb::Cache* blockCache) {
+        if (!hasPending_.load(std::memory_order_acquire)) return;
+        std::vector<Pending> batch;
+        {
+            std::lock_guard lock(pendingMutex_);
+            batch.swap(pending_);
+            hasPending_.store(false, std::memory_order_relaxed);
+        }
+        for (auto& p : batch) {
+            if (leveldb::Cache::Handle* resident = blockCache->Lookup(p.key)) {
+                blockCache->Release(resident);
+                continue;
+            }
+            Store(p);
+        }
+    }
+
+    // Unpacks the block at key into block and drops it from this tier, which it only re-enters on
+    // its next eviction. False if it isn't here.
+    bool Promote(const leveldb::Slice& key, CachedBlock& block, size_t& charge) {
+        leveldb::Cache::Handle* handle = cache_->Lookup(key);
+        if (!handle) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        auto* packed = static_cast<const PackedBlock*>(cache_->Value(handle));
+        block.data = std::make_unique_for_overwrite<uint8_t[]>(std::max<size_t>(packed->size, 1));
+        block.size = packed->size;
+        bool ok = true;
+        if (packed->stored) memcpy(block.data.get(), packed->data.get(), packed->size);
+        else ok = Lz4Decompress(packed->data.get(), packed->packedSize, block.data.get(), packed->size);
+        cache_->Release(handle);
+        cache_->Erase(key);
+        (ok ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+        charge = block.size;
+        return ok;
+    }
+
+    void GetStats(BlockCacheStats& out) const {
+        out.secondaryBytes = cache_->TotalCharge();
+        out.secondaryHits = hits_.load(std::memory_order_relaxed);
+        out.secondaryMisses = misses_.load(std::memory_order_relaxed);
+        out.demotedBlocks = demoted_.load(std::memory_order_relaxed);
+        out.demotedBytes = demotedBytes_.load(std::memory_order_relaxed);
+        out.packedBytes = packedBytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Pending {
+        std::string key;
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+    struct PackedBlock {
+        std::unique_ptr<uint8_t[]> data;
+        size_t packedSize = 0;
+        size_t size = 0;
+        bool stored = false; // Didn't pack well enough, so kept as is; still saves the inflate
+    };
+
+    static void DeletePackedBlock(const leveldb::Slice&, void* value) {
+        delete static_cast<PackedBlock*>(value);
+    }
+
+    void Store(Pending& p) {
+        thread_local std::vector<uint8_t> scratch;
+        auto packed = std::make_unique<PackedBlock>();
+        packed->size = p.size;
+        // Packing has to save at least an eighth to be worth unpacking on every promotion.
+        size_t limit = p.size - p.size / 8;
+        if (scratch.size() < limit) scratch.resize(limit);
+        size_t n = limit ? Lz4Compress(p.data.get(), p.size, scratch.data(), limit) : 0;
+        if (n) {
+            packed->data = std::make_unique_for_overwrite<uint8_t[]>(n);
+            memcpy(packed->data.get(), scratch.data(), n);
+            packed->packedSize = n;
+        } else {
+            packed->data = std::move(p.data);
+            packed->packedSize = p.size;
+            packed->stored = true;
+        }
+        demoted_.fetch_add(1, std::memory_order_relaxed);
+        demotedBytes_.fetch_add(p.size, std::memory_order_relaxed);
+        packedBytes_.fetch_add(packed->packedSize, std::memory_order_relaxed);
+        size_t charge = packed->packedSize + sizeof(PackedBlock);
+        cache_->Release(cache_->Insert(p.key, packed.release(), charge, &DeletePackedBlock));
+    }
+
+    std::unique_ptr<leveldb::Cache> cache_; // Same key as blockCache -> PackedBlock*, charged by packed size
+    std::mutex pendingMutex_;
+    std::vector<Pending> pending_;
+    std::atomic<bool> hasPending_ = false;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> demoted_ = 0;
+    std::atomic<uint64_t> demotedBytes_ = 0;
+    std::atomic<uint64_t> packedBytes_ = 0;
+};
+
+static void DeleteCachedBlock(const leveldb::Slice& key, void* value) {
+    auto* block = static_cast<CachedBlock*>(value);
+    if (block->demoteTo) block->demoteTo->Demote(key, std::move(block->data), block->size);
+    delete block;
+}
+
+// Keeps a block's bytes alive while it is being read: a block cache entry for a decompressed block,
+// nothing for one read in place (the caller's TableRef already pins the mapping).
+class BlockRef {
+public:
+    BlockRef() = default;
+    BlockRef(const BlockRef&) = delete;
+    BlockRef& operator=(const BlockRef&) = delete;
+    ~BlockRef() { Reset(); }
+
+    void Reset() {
+        if (handle_) cache_->Release(handle_);
+        handle_ = nullptr;
+    }
+    void Pin(leveldb::Cache* cache, leveldb::Cache::Handle* handle) {
+        Reset();
+        cache_ = cache;
+        handle_ = handle;
+    }
+    const CachedBlock* block() const { return static_cast<const CachedBlock*>(cache_->Value(handle_)); }
+
+private:
+    leveldb::Cache* cache_ = nullptr;
+    leveldb::Cache::Handle* handle_ = nullptr;
+};
+
+// Key of the block at offset of the table with the given cacheId in BedrockDB::blockCache.
+static inline leveldb::Slice BlockCacheKey(char (&key)[16], uint64_t cacheId, uint64_t offset) {
+    memcpy(key, &cacheId, 8);
+    memcpy(key + 8, &offset, 8);
+    return leveldb::Slice(key, sizeof(key));
+}
+
+// Reads the block at h of a mapped table: checks its trailer when the table verifies, then points
+// view at the bytes in place or at the (cached) decompressed copy. A block cache miss tries the
+// secondary tier before the file.
+static BlockStatus ReadTableBlock(BedrockDB* db, const OpenTable& t, const BlockHandle& h, BlockRef& ref, BlockView& view) {
+    if (h.offset > t.fileSize || h.size + kBlockTrailerSize > t.fileSize - h.offset) return BlockStatus::Corrupt;
+    const uint8_t* raw = t.mapped + h.offset;
+    const uint8_t type = raw[h.size];
+    if (type == leveldb::kNoCompression) {
+        if (t.verify && !MaskedCrcMatches(raw + h.size + 1, raw, (size_t)h.size + 1)) return BlockStatus::Corrupt;
+        CountStat(kStatBlocksRead);
+        CountStat(kStatBlockBytesRead, h.size);
+        return InitBlockView(raw, (size_t)h.size, view) ? BlockStatus::Ok : BlockStatus::Corrupt;
+    }
+
+    leveldb::Cache* cache = db->blockCache.get();
+    SecondaryBlockCache* secondary = db->secondaryCache.get();
+    char key[16];
+    leveldb::Slice cacheKey = BlockCacheKey(key, t.cacheId, h.offset);
+    leveldb::Cache::Handle* handle = cache->Lookup(cacheKey);
+    if (!handle) {
+        auto block = std::make_unique<CachedBlock>();
+        size_t charge = 0;
+        if (!secondary || !secondary->Promote(cacheKey, *block, charge)) {
+            if (t.verify && !MaskedCrcMatches(raw + h.size + 1, raw, (size_t)h.size + 1)) return BlockStatus::Corrupt;
+            BlockStatus status = DecompressBlock(type, raw, (size_t)h.size, block->data, block->size, charge);
+            if (status != BlockStatus::Ok) return status;
+            CountStat(kStatBlocksRead);
+            CountStat(kStatBlockBytesRead, h.size);
+        }
+        // Another miss on the same block may have inserted it meanwhile; replacing its entry would
+        // only send a second copy down to the secondary tier.
+        handle = cache->Lookup(cacheKey);
+        if (!handle) {
+            block->demoteTo = secondary;
+            handle = cache->Insert(cacheKey, block.release(), charge + sizeof(CachedBlock), &DeleteCachedBlock);
+        }
+        if (secondary) secondary->DrainDemoted(cache);
+    }
+    ref.Pin(cache, handle);
+    const CachedBlock* block = ref.block();
+    return InitBlockView(block->data.get(), block->size, view) ? BlockStatus::Ok : BlockStatus::Corrupt;
+}
+
+// Reads the footer and index block of a freshly mapped table so point lookups can skip leveldb.
+// Leaves t.index empty if the index can't be decoded here.
+static void LoadNativeIndex(OpenTable& t) {
+    if (!t.mapped || t.fileSize < kTableFooterSize) return;
+    const uint8_t* footer = t.mapped + t.fileSize - kTableFooterSize;
+    uint64_t magic;
+    memcpy(&magic, footer + kTableFooterSize - 8, sizeof(magic));
+    BlockHandle metaindex, index;
+    const uint8_t* p = footer;
+    if (magic != kTableMagic || !DecodeBlockHandle(p, footer + kTableFooterSize - 8, metaindex) || !DecodeBlockHandle(p, footer + kTableFooterSize - 8, index)) return;
+    if (index.offset > t.fileSize || index.size + kBlockTrailerSize > t.fileSize - index.offset) return;
+
+    const uint8_t* raw = t.mapped + index.offset;
+    const uint8_t type = raw[index.size];
+    if (t.verify && !MaskedCrcMatches(raw + index.size + 1, raw, (size_t)index.size + 1)) return;
+    if (type == leveldb::kNoCompression) {
+        InitBlockView(raw, (size_t)index.size, t.index);
+        return;
+    }
+    size_t size = 0, charge = 0;
+    if (DecompressBlock(type, raw, (size_t)index.size, t.indexStorage, size, charge) != BlockStatus::Ok ||
+        !InitBlockView(t.indexStorage.get(), size, t.index)) {
+        t.index = {};
+        t.indexStorage.reset();
+    }
+}
+
+// Read-only mapping of an immutable .ldb. Reads hand out pointers straight into the view, so
+// leveldb skips its own copy and the lookup path can prefetch blocks before seeking to them.
+class MappedTableFile final : public leveldb::RandomAccessFile {
+public:
+    NativeFile file = kNoFile;
+    FileView view;
+    bool verify = false;
+
+    ~MappedTableFile() override {
+        UnmapFile(view);
+        CloseNativeFile(file);
+    }
+
+    leveldb::Status Read(uint64_t offset, size_t n, leveldb::Slice* result, char* /*scratch*/) const override {
+        if (offset > view.size) { *result = leveldb::Slice(); return leveldb::Status::IOError("read past end of table"); }
+        *result = leveldb::Slice(reinterpret_cast<const char*>(view.data + offset), static_cast<size_t>(std::min<uint64_t>(n, view.size - offset)));
+        CountStat(kStatBlocksRead);
+        CountStat(kStatBlockBytesRead, result->size());
+        if (verify && !BlockReadIntact(offset, *result, view.size)) return leveldb::Status::Corruption("block checksum mismatch");
+        return leveldb::Status::OK();
+    }
+};
+
+// Checks the blocks read through a file that couldn't be mapped.
+class ChecksummedFile final : public leveldb::RandomAccessFile {
+public:
+    ChecksummedFile(leveldb::RandomAccessFile* base, uint64_t size) : base_(base), size_(size) {}
+
+    leveldb::Status Read(uint64_t offset, size_t n, leveldb::Slice* result, char* scratch) const override {
+        leveldb::Status s = base_->Read(offset, n, result, scratch);
+        if (s.ok() && !BlockReadIntact(offset, *result, size_)) return leveldb::Status::Corruption("block checksum mismatch");
+        return s;
+    }
+
+private:
+    std::unique_ptr<leveldb::RandomAccessFile> base_;
+    uint64_t size_;
+};
+
+static MappedTableFile* MapTableFile(const std::string& fullPath, bool verify) {
+    auto file = std::make_unique<MappedTableFile>();
+    file->verify = verify;
+    file->file = OpenReadOnlyFile(fullPath, FileAccess::Random);
+    if (file->file == kNoFile) return nullptr;
+    uint64_t size;
+    if (!NativeFileSize(file->file, size) || !MapFile(file->file, size, FileAccess::Random, file->view)) return nullptr;
+    return file.release();
+}
+
+static OpenTable* OpenTableFile(const std::string& fullPath, uint64_t cacheId, bool verify) {
+    TraceSpan span("open table");
+    leveldb::RandomAccessFile* file = nullptr;
+    const uint8_t* mapped = nullptr;
+    uint64_t size = 0;
+
+    if (MappedTableFile* mf = MapTableFile(fullPath, verify)) {
+        file = mf; mapped = mf->view.data; size = mf->view.size;
+    }
+    else {
+        leveldb::Env* env = leveldb::Env::Default();
+        if (!env->NewRandomAccessFile(fullPath, &file).ok()) return nullptr;
+
+        std::error_code ec;
+        size = static_cast<uint64_t>(std::filesystem::file_size(fullPath, ec));
+        if (ec) { delete file; return nullptr; }
+        if (verify) file = new ChecksummedFile(file, size);
+    }
+
+    leveldb::Options opts; opts.compression = leveldb::kNoCompression;
+    leveldb::Table* table = nullptr;
+    if (!leveldb::Table::Open(opts, file, size, &table).ok()) {
+        delete file; return nullptr;
+    }
+
+    auto t = new OpenTable();
+    t->file = file; t->table = table; t->mapped = mapped; t->fileSize = size;
+    t->cacheId = cacheId; t->verify = verify;
+    LoadNativeIndex(*t);
+    return t;
+}
+
+static void DeleteOpenTable(const leveldb::Slice&, void* value) {
+    auto* t = static_cast<OpenTable*>(value);
+    delete t->table; delete t->file; delete t;
+}
+
+// Pins an opened table in the table cache for as long as it is alive.
+class TableRef {
+public:
+    TableRef() = default;
+    TableRef(leveldb::Cache* cache, leveldb::Cache::Handle* handle) : cache_(cache), handle_(handle) {}
+    TableRef(TableRef&& o) noexcept : cache_(o.cache_), handle_(std::exchange(o.handle_, nullptr)) {}
+    TableRef& operator=(TableRef&& o) noexcept {
+        if (this != &o) { Reset(); cache_ = o.cache_; handle_ = std::exchange(o.handle_, nullptr); }
+        return *this;
+    }
+    ~TableRef() { Reset(); }
+
+    void Reset() { if (handle_) { cache_->Release(handle_); handle_ = nullptr; } }
+    explicit operator bool() const { return handle_ != nullptr; }
+    const OpenTable* get() const { return static_cast<const OpenTable*>(cache_->Value(handle_)); }
+    const OpenTable* operator->() const { return get(); }
+
+private:
+    leveldb::Cache* cache_ = nullptr;
+    leveldb::Cache::Handle* handle_ = nullptr;
+};
+
+// Returns the opened table, opening the file on first touch. Concurrent misses may both open the
+// file; the later insert wins and the other copy is closed once its last reader releases it.
+static TableRef AcquireTable(BedrockDB* db, const SSTable& t) {
+    char buf[sizeof(t.slot->id)];
+    memcpy(buf, &t.slot->id, sizeof(buf));
+    leveldb::Slice key(buf, sizeof(buf));
+    leveldb::Cache* cache = db->tableCache.get();
+    if (auto* h = cache->Lookup(key)) { CountStat(kStatTableCacheHits); return TableRef(cache, h); }
+    CountStat(kStatTableCacheMisses);
+    OpenTable* opened = OpenTableFile(t.path, t.slot->id, db->options.verifyChecksums != 0);
+    if (!opened) return {};
+    return TableRef(cache, cache->Insert(key, opened, 1, &DeleteOpenTable));
+}
+
+// Opens the given tables concurrently and leaves them in the table cache. Each open is a few small
+// dependent reads (footer, index, metaindex), so this is bound by I/O latency, not CPU.
+static void PreopenTables(BedrockDB* db, const std::vector<const SSTable*>& tables) {
+    size_t count = std::min(tables.size(), (size_t)db->options.maxOpenTables);
+    ParallelFor(size_t(0), count, [&](size_t i) { AcquireTable(db, *tables[i]); });
+}
+
+static void CloseSingleLog(MappedLog* log) {
+    if (!log) return;
+    UnmapFile(log->view);
+    CloseNativeFile(log->file);
+}
+
+static bool RemapLogIfNeeded(MappedLog* log) {
+    TraceSpan span("remap log");
+    if (!log || log->file == kNoFile) return false;
+    uint64_t currentOnDiskSize;
+    if (!NativeFileSize(log->file, currentOnDiskSize)) { CloseSingleLog(log); return false; }
+    if (currentOnDiskSize == 0) { CloseSingleLog(log); return false; }
+    if (currentOnDiskSize == log->view.size) return true;
+    return MapFile(log->file, currentOnDiskSize, FileAccess::Sequential, log->view);
+}
+
+// Key comparison policies. Chunk keys are x, z, optional dim and a tag byte, so they are
+// always 9 or 13 bytes; for those the compare is two (overlapping) 64-bit loads instead of
+// a length-dependent memcmp. Anything else falls through to the generic byte compare.
+enum class KeyKind { Generic, Chunk9, Chunk13 };
+
+struct GenericKeyOps {
+    static inline bool Equal(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0;
+    }
+    static inline int Compare(std::string_view a, std::string_view b) { return a.compare(b); }
+};
+
+template <size_t N>
+struct FixedKeyOps {
+    static_assert(N > 8 && N <= 16, "fixed keys are loaded as two 64-bit words");
+    static constexpr size_t kTail = N - 8;
+
+    static inline uint64_t Load(const char* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+    // Big-endian words order the same as memcmp.
+    static inline uint64_t LoadOrdered(const char* p) {
+        if constexpr (std::endian::native == std::endian::little) return std::byteswap(Load(p));
+        else return Load(p);
+    }
+
+    static inline bool Equal(std::string_view a, std::string_view b) {
+        if (a.size() != N || b.size() != N) return GenericKeyOps::Equal(a, b);
+        return ((Load(a.data()) ^ Load(b.data())) | (Load(a.data() + kTail) ^ Load(b.data() + kTail))) == 0;
+    }
+
+    static inline int Compare(std::string_view a, std::string_view b) {
+        if (a.size() != N || b.size() != N) return a.compare(b);
+        uint64_t x = LoadOrdered(a.data()), y = LoadOrdered(b.data());
+        if (x == y) { x = LoadOrdered(a.data() + kTail); y = LoadOrdered(b.data() + kTail); }
+        return (x > y) - (x < y);
+    }
+};
+
+static KeyKind ClassifyKeys(const int32_t* keyLengths, int32_t count) {
+    if (count <= 0) return KeyKind::Generic;
+    int32_t len = keyLengths[0];
+    if (len != 9 && len != 13) return KeyKind::Generic;
+    for (int32_t i = 1; i < count; ++i) if (keyLengths[i] != len) return KeyKind::Generic;
+    return len == 9 ? KeyKind::Chunk9 : KeyKind::Chunk13;
+}
+
+// Calls f with a key-ops tag object so the hot loop is instantiated once per key kind.
+template <typename Func>
+static void WithKeyOps(KeyKind kind, Func&& f) {
+    switch (kind) {
+    case KeyKind::Chunk9: f(FixedKeyOps<9>{}); break;
+    case KeyKind::Chunk13: f(FixedKeyOps<13>{}); break;
+    default: f(GenericKeyOps{}); break;
+    }
+}
+
+struct TempResult {
+    std::vector<uint8_t> data;
+    bool found;
+};
+
+// Copies the found values of results into one malloc'd block for the host, which frees it with
+// FreeBuffer.
+static uint8_t* PackResults(const TempResult* results, int32_t count, int32_t* outDataOffsets, int32_t* outDataLengths, uint8_t* outFound) {
+    TraceSpan span("copy out");
+    size_t totalSize = 0;
+    for (int i = 0; i < count; ++i) {
+        if (results[i].found) totalSize += results[i].data.size();
+    }
+
+    uint8_t* dataBlock = (uint8_t*)malloc(totalSize > 0 ? totalSize : 1);
+    size_t currentOffset = 0;
+
+    for (int i = 0; i < count; ++i) {
+        outFound[i] = results[i].found ? 1 : 0;
+        if (results[i].found) {
+            size_t len = results[i].data.size();
+            memcpy(dataBlock + currentOffset, results[i].data.data(), len);
+            outDataOffsets[i] = (int32_t)currentOffset;
+            outDataLengths[i] = (int32_t)len;
+            currentOffset += len;
+        }
+        else {
+            outDataOffsets[i] = 0;
+            outDataLengths[i] = 0;
+        }
+    }
+    return dataBlock;
+}
+
+// Internal keys carry an 8-byte sequence/type trailer after the user key.
+static inline std::string_view UserKey(std::string_view internalKey) {
+    return internalKey.size() > 8 ? internalKey.substr(0, internalKey.size() - 8) : internalKey;
+}
+
+enum class NativeProbe { Found, Missing, Fallback };
+
+// Where a lookup found its key: enough to come back to the value without searching again.
+struct ValueLocation {
+    BlockHandle block;
+    uint32_t entry = 0; // Offset of the key's entry in the (decompressed) block
+    bool known = false; // Only the native path can tell
+};
+
+// Point lookup through the native block path: seek the index, then the data block it points at,
+// moving on to the next block when the key sorts past the last entry of the first.
+template <typename KeyOps>
+static NativeProbe ProbeTableNative(BedrockDB* db, const OpenTable& t, std::string_view target, std::vector<uint8_t>& buffer, ValueLocation* loc = nullptr) {
+    BlockIter index(t.index);
+    bool more = index.Seek(target);
+    for (; more; more = index.Next()) {
+        BlockHandle h;
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(index.value().data());
+        if (!DecodeBlockHandle(p, p + index.value().size(), h)) return NativeProbe::Fallback;
+        BlockRef ref;
+        BlockView view;
+        if (ReadTableBlock(db, t, h, ref, view) != BlockStatus::Ok) return NativeProbe::Fallback;
+        BlockIter it(view);
+        if (it.Seek(target)) {
+            if (!KeyOps::Equal(UserKey(it.key()), target)) return NativeProbe::Missing;
+            buffer.assign(reinterpret_cast<const uint8_t*>(it.value().data()), reinterpret_cast<const uint8_t*>(it.value().data()) + it.value().size());
+            if (loc) *loc = { h, it.offset(), true };
+            return NativeProbe::Found;
+        }
+        if (it.Corrupt()) return NativeProbe::Fallback;
+    }
+    return index.Corrupt() ? NativeProbe::Fallback : NativeProbe::Missing;
+}
+
+// Seeks a single table for key; copies the value out on an exact user-key match, and says where it
+// was found if loc is given and the native path found it.
+template <typename KeyOps>
+static inline bool ProbeTable(BedrockDB* db, const OpenTable* t, const leveldb::Slice& target, std::vector<uint8_t>& buffer, ValueLocation* loc = nullptr) {
+    if (t->index.data) {
+        NativeProbe probe = ProbeTableNative<KeyOps>(db, *t, std::string_view(target.data(), target.size()), buffer, loc);
+        if (probe != NativeProbe::Fallback) return probe == NativeProbe::Found;
+    }
+    std::unique_ptr<leveldb::Iterator> it(t->table->NewIterator(db->readOptions));
+    it->Seek(target);
+    if (!it->Valid()) return false;
+
+    leveldb::Slice raw = it->key();
+    size_t rawSize = raw.size();
+    size_t userSize = rawSize > 8 ? rawSize - 8 : rawSize;
+
+    if (KeyOps::Equal(std::string_view(raw.data(), userSize), std::string_view(target.data(), target.size()))) {
+        leveldb::Slice v = it->value();
+        buffer.assign((const uint8_t*)v.data(), (const uint8_t*)v.data() + v.size());
+        return true;
+    }
+    return false;
+}
+
+constexpr size_t kMaxHintKeyBytes = 16; // Chunk keys are 9 to 14 bytes; longer keys aren't hinted
+constexpr uint32_t kHintNoTable = 0xFFFFFF; // The key was in none of the tables
+
+// Per-key memo of where the last lookup ended: the table, data block and entry that held the key,
+// or that no table did. A hint is only trusted under the table-set generation it was recorded at,
+// and a set never changes within a generation, so following one gives the same answer as the
+// search it skips. Direct-mapped, with a seqlock per slot: readers never wait, and a writer that
+// finds its slot busy drops its hint.
+class LocationHints {
+public:
+    struct Hint {
+        uint32_t table; // Index into TableSet::tables, or kHintNoTable
+        ValueLocation loc;
+    };
+
+    explicit LocationHints(size_t slots) : mask_(std::bit_ceil(std::max<size_t>(slots, 1)) - 1), slots_(new Slot[mask_ + 1]) {}
+
+    bool Find(std::string_view key, uint64_t generation, Hint& out) const {
+        uint64_t k[2];
+        if (!PackKey(key, k)) return false;
+        const Slot& s = slots_[Index(k, key.size())];
+        uint64_t seq = s.seq.load(std::memory_order_acquire);
+        if (seq & 1) return false;
+        uint64_t k0 = s.key[0].load(std::memory_order_relaxed);
+        uint64_t k1 = s.key[1].load(std::memory_order_relaxed);
+        uint64_t meta = s.meta.load(std::memory_order_relaxed);
+        uint64_t gen = s.generation.load(std::memory_order_relaxed);
+        uint64_t blockOffset = s.blockOffset.load(std::memory_order_relaxed);
+        uint64_t blockSize = s.blockSize.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != seq) return false;
+        if (gen != generation + 1 || k0 != k[0] || k1 != k[1] || (meta >> 56) != key.size()) return false;
+        out.table = uint32_t(meta >> 32) & kHintNoTable;
+        out.loc = { { blockOffset, blockSize }, uint32_t(meta), true };
+        return true;
+    }
+
+    void Store(std::string_view key, uint64_t generation, uint32_t table, const ValueLocation& loc) {
+        uint64_t k[2];
+        if (!PackKey(key, k) || table > kHintNoTable) return;
+        Slot& s = slots_[Index(k, key.size())];
+        uint64_t seq = s.seq.load(std::memory_order_relaxed);
+        if ((seq & 1) || !s.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed)) return;
+        std::atomic_thread_fence(std::memory_order_release);
+        s.key[0].store(k[0], std::memory_order_relaxed);
+        s.key[1].store(k[1], std::memory_order_relaxed);
+        s.meta.store(uint64_t(key.size()) << 56 | uint64_t(table) << 32 | loc.entry, std::memory_order_relaxed);
+        s.generation.store(generation + 1, std::memory_order_relaxed); // 0 marks an empty slot
+        s.blockOffset.store(loc.block.offset, std::memory_order_relaxed);
+        s.blockSize.store(loc.block.size, std::memory_order_relaxed);
+        s.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    void Count(uint64_t hits, uint64_t misses) {
+        if (hits) hits_.fetch_add(hits, std::memory_order_relaxed);
+        if (misses) misses_.fetch_add(misses, std::memory_order_relaxed);
+    }
+
+    void GetStats(BlockCacheStats& out) const {
+        out.hintHits = hits_.load(std::memory_order_relaxed);
+        out.hintMisses = misses_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> seq = 0; // Odd while a writer is in the slot
+        std::atomic<uint64_t> key[2] = {};
+        std::atomic<uint64_t> meta = 0; // keyLen(8) table(24) entry(32)
+        std::atomic<uint64_t> generation = 0;
+        std::atomic<uint64_t> blockOffset = 0;
+        std::atomic<uint64_t> blockSize = 0;
+    };
+
+    static bool PackKey(std::string_view key, uint64_t (&k)[2]) {
+        if (key.empty() || key.size() > kMaxHintKeyBytes) return false;
+        k[0] = k[1] = 0;
+        memcpy(k, key.data(), key.size());
+        return true;
+    }
+    size_t Index(const uint64_t (&k)[2], size_t len) const {
+        uint64_t h = (k[0] * 0x9E3779B97F4A7C15ull) ^ (k[1] * 0xC2B2AE3D27D4EB4Full) ^ len;
+        return size_t(h ^ (h >> 29)) & mask_;
+    }
+
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+};
+
+// The value of the entry at offset in block, without rebuilding its key.
+static bool EntryValueAt(const BlockView& view, uint32_t offset, std::string_view& value) {
+    if (offset >= view.restartsOffset) return false;
+    const uint8_t* p = view.data + offset;
+    const uint8_t* limit = view.data + view.restartsOffset;
+    uint64_t shared, nonShared, valueLen;
+    if (!GetVarint64(p, limit, shared) || !GetVarint64(p, limit, nonShared) || !GetVarint64(p, limit, valueLen) ||
+        nonShared + valueLen > uint64_t(limit - p)) return false;
+    value = std::string_view(reinterpret_cast<const char*>(p + nonShared), (size_t)valueLen);
+    return true;
+}
+
+// Answers a key from its location hint. False when there is none or it can't be followed (the
+// table failed to open, say), and the key takes the normal search.
+static bool LookupByHint(BedrockDB* db, const TableSet& set, std::string_view key, TempResult& r) {
+    LocationHints::Hint hint;
+    if (!db->hints->Find(key, set.generation, hint)) return false;
+    if (hint.table == kHintNoTable) {
+        r.found = false;
+        return true;
+    }
+    if (hint.table >= set.tables.size()) return false;
+    TableRef t = AcquireTable(db, *set.tables[hint.table]);
+    if (!t || !t->index.data) return false;
+    BlockRef ref;
+    BlockView view;
+    std::string_view value;
+    if (ReadTableBlock(db, *t.get(), hint.loc.block, ref, view) != BlockStatus::Ok || !EntryValueAt(view, hint.loc.entry, value)) return false;
+    r.data.assign(reinterpret_cast<const uint8_t*>(value.data()), reinterpret_cast<const uint8_t*>(value.data()) + value.size());
+    r.found = true;
+    return true;
+}
+
+// Chunk index: a minimal perfect hash over every chunk key of one tag, plus their values, in one
+// read-only file built offline by BuildChunkIndex for worlds that no longer change.
+//   ChunkIndexHeader | pilots uint32[bucketCount] | remap uint32[tableSize - keyCount]
+//   | ChunkIndexSlot[keyCount] | values
+// The hash is PTHash's: a key's bucket picks a pilot, and the pilot moves the key's hash to a
+// position of its own in [0, tableSize). Positions past keyCount are remapped onto the holes below
+// it. A lookup is one hash, a pilot read and a slot read; the slot holds the whole key, so keys the
+// index never saw are told apart from the ones it holds. Since the index covers every live key of
+// its tag, a key it doesn't hold is a miss without touching the tables.
+
+constexpr char kChunkIndexMagic[8] = { 'L', 'D', 'B', 'M', 'C', 'I', 'X', '1' };
+constexpr uint32_t kChunkIndexVersion = 1;
+constexpr size_t kChunkIndexKeyBytes = 16;
+constexpr double kChunkIndexLoadFactor = 0.98;     // keyCount / tableSize
+constexpr double kChunkIndexBucketFactor = 5.0;    // PTHash's c: bucketCount = c * n / log2(n)
+constexpr uint64_t kChunkIndexDenseKeys = 0x9999999999999999ull; // 60% of hashes...
+constexpr uint64_t kChunkIndexDenseBuckets = 3;    // ...go to the first 3/10 of the buckets
+constexpr uint32_t kChunkIndexMaxPilot = 1 << 20;  // Past this the seed is hopeless; try the next one
+constexpr int kChunkIndexMaxSeeds = 16;
+
+// Persistent layout, little-endian like everything else here.
+struct ChunkIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tag;
+    uint64_t fingerprint; // FingerprintTables of the db it was built from
+    uint64_t seed;
+    uint64_t keyCount;
+    uint64_t tableSize;
+    uint64_t bucketCount;
+    uint64_t pilotsOffset;
+    uint64_t remapOffset;
+    uint64_t slotsOffset;
+    uint64_t valuesOffset;
+    uint64_t valuesBytes;
+};
+
+struct ChunkIndexSlot {
+    uint8_t key[kChunkIndexKeyBytes];
+    uint64_t valueOffset; // From ChunkIndexHeader::valuesOffset
+    uint32_t valueLen;
+    uint32_t keyLen;
+};
+
+static_assert(sizeof(ChunkIndexHeader) == 96 && sizeof(ChunkIndexSlot) == 32, "chunk index layout is persistent");
+
+// Chunk keys are x, z[, dim], tag, and sub-chunk records add an index byte after the tag.
+static inline bool IsChunkKeyOfTag(std::string_view key, uint8_t tag) {
+    size_t n = key.size();
+    if (n == 9 || n == 13) return uint8_t(key[n - 1]) == tag;
+    if (n == 10 || n == 14) return uint8_t(key[n - 2]) == tag;
+    return false;
+}
+
+static inline uint64_t Mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t ChunkIndexHash(std::string_view key, uint64_t seed) {
+    uint64_t w[2] = {};
+    memcpy(w, key.data(), std::min(key.size(), kChunkIndexKeyBytes));
+    return Mix64(Mix64(w[0] ^ seed ^ (uint64_t(key.size()) << 56)) + w[1]);
+}
+
+// Skewed like PTHash's: the dense buckets are placed first, while there is still room for them.
+static inline uint64_t ChunkIndexBucket(uint64_t h, uint64_t bucketCount) {
+    uint64_t dense = std::max<uint64_t>(1, bucketCount * kChunkIndexDenseBuckets / 10);
+    uint64_t r = Mix64(h ^ 0x9E3779B97F4A7C15ull);
+    return h < kChunkIndexDenseKeys ? r % dense : dense + r % (bucketCount - dense);
+}
+
+static inline uint64_t ChunkIndexPosition(uint64_t h, uint32_t pilot, uint64_t tableSize) {
+    return (h ^ Mix64(uint64_t(pilot) + 0xC2B2AE3D27D4EB4Full)) % tableSize;
+}
+
+// Identifies the tables a set was built from: every .ldb's name and size, in name order. A chunk
+// index is only used by a db whose tables fingerprint the same as the ones it was built from.
+static uint64_t FingerprintTables(const TableSet& set) {
+    std::vector<std::pair<std::string, uint64_t>> files;
+    files.reserve(set.tables.size());
+    for (auto const& t : set.tables) files.emplace_back(std::filesystem::path(t->path).filename().string(), t->fileSize);
+    std::sort(files.begin(), files.end());
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    auto mix = [&](const void* data, size_t n) {
+        for (size_t i = 0; i < n; ++i) { h ^= static_cast<const uint8_t*>(data)[i]; h *= 1099511628211ull; }
+    };
+    for (auto const& [name, size] : files) {
+        mix(name.data(), name.size());
+        mix(&size, sizeof(size));
+    }
+    return h;
+}
+
+struct ChunkIndex {
+    NativeFile file = kNoFile;
+    FileView view;
+    ChunkIndexHeader header{};
+    const uint32_t* pilots = nullptr;
+    const uint32_t* remap = nullptr;
+    const ChunkIndexSlot* slots = nullptr;
+    const uint8_t* values = nullptr;
+
+    ~ChunkIndex() {
+        UnmapFile(view);
+        CloseNativeFile(file);
+    }
+
+    bool Covers(std::string_view key) const { return IsChunkKeyOfTag(key, (uint8_t)header.tag); }
+
+    // Answers key if the index covers it. False leaves it to the tables, which is also what a
+    // damaged slot does.
+    bool Lookup(std::string_view key, TempResult& r) const {
+        if (!Covers(key)) return false;
+        r.found = false;
+        if (header.keyCount == 0) return true;
+        uint64_t h = ChunkIndexHash(key, header.seed);
+        uint64_t pos = ChunkIndexPosition(h, pilots[ChunkIndexBucket(h, header.bucketCount)], header.tableSize);
+        if (pos >= header.keyCount) pos = remap[pos - header.keyCount];
+        if (pos >= header.keyCount) return false;
+        const ChunkIndexSlot& slot = slots[pos];
+        if (slot.keyLen != key.size() || memcmp(slot.key, key.data(), key.size()) != 0) return true;
+        if (slot.valueOffset > header.valuesBytes || slot.valueLen > header.valuesBytes - slot.valueOffset) return false;
+        r.data.assign(values + slot.valueOffset, values + slot.valueOffset + slot.valueLen);
+        r.found = true;
+        return true;
+    }
+};
+
+static bool SectionFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t alignment, uint64_t fileSize) {
+    return offset % alignment == 0 && count <= fileSize / elementSize && offset <= fileSize - count * elementSize;
+}
+
+// Maps the chunk index at path if it is intact and was built from tables that fingerprint the same.
+static std::shared_ptr<const ChunkIndex> OpenChunkIndex(const std::string& path, uint64_t fingerprint) {
+    TraceSpan span("open chunk index");
+    auto index = std::make_shared<ChunkIndex>();
+    index->file = OpenReadOnlyFile(path, FileAccess::Random);
+    uint64_t size;
+    if (index->file == kNoFile || !NativeFileSize(index->file, size) || size < sizeof(ChunkIndexHeader) ||
+        !MapFile(index->file, size, FileAccess::Random, index->view)) return nullptr;
+
+    ChunkIndexHeader& hdr = index->header;
+    memcpy(&hdr, index->view.data, sizeof(hdr));
+    if (memcmp(hdr.magic, kChunkIndexMagic, sizeof(hdr.magic)) != 0 || hdr.version != kChunkIndexVersion || hdr.fingerprint != fingerprint) return nullptr;
+    if (hdr.tag > 0xFF || hdr.keyCount > hdr.tableSize || hdr.tableSize > UINT32_MAX) return nullptr;
+    if (hdr.keyCount && hdr.bucketCount < 2) return nullptr;
+    if (!SectionFits(hdr.pilotsOffset, hdr.bucketCount, sizeof(uint32_t), alignof(uint32_t), size) ||
+        !SectionFits(hdr.remapOffset, hdr.tableSize - hdr.keyCount, sizeof(uint32_t), alignof(uint32_t), size) ||
+        !SectionFits(hdr.slotsOffset, hdr.keyCount, sizeof(ChunkIndexSlot), alignof(ChunkIndexSlot), size) ||
+        !SectionFits(hdr.valuesOffset, hdr.valuesBytes, 1, 1, size)) return nullptr;
+    index->pilots = reinterpret_cast<const uint32_t*>(index->view.data + hdr.pilotsOffset);
+    index->remap = reinterpret_cast<const uint32_t*>(index->view.data + hdr.remapOffset);
+    index->slots = reinterpret_cast<const ChunkIndexSlot*>(index->view.data + hdr.slotsOffset);
+    index->values = index->view.data + hdr.valuesOffset;
+    return index;
+}
+
+static inline void PrefetchRange(const uint8_t* p, size_t len) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    for (size_t off = 0; off < len; off += 64) _mm_prefetch(reinterpret_cast<const char*>(p + off), _MM_HINT_T0);
+#else
+    for (size_t off = 0; off < len; off += 64) __builtin_prefetch(p + off, 0, 3);
+#endif
+}
+
+constexpr uint64_t kPageSize = 4096;
+constexpr uint64_t kColdBlockReadBytes = 16 * 1024;
+
+// Index of the first table of set whose key range covers key, which every lookup of key probes
+// first; tables.size() if there is none.
+static size_t FirstCoveringTable(const TableSet& set, std::string_view key) {
+    size_t ti = 0;
+    while (ti < set.tables.size() && !TableMayContain<GenericKeyOps>(*set.tables[ti], key)) ++ti;
+    return ti;
+}
+
+// Finds the data block the native index of t sends key to; false if t has no native index or key
+// sorts past its last block.
+static bool LocateDataBlock(const OpenTable& t, std::string_view key, BlockHandle& h) {
+    if (!t.index.data) return false;
+    BlockIter index(t.index);
+    if (!index.Seek(key)) return false;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(index.value().data());
+    return DecodeBlockHandle(p, p + index.value().size(), h);
+}
+
+// Resolves every key of the batch to the data block its lookup will search first and hands all of
+// those blocks, merged where they touch, to PrefetchMemory before any seek runs. The reads are
+// queued without waiting, so a cold batch's reads overlap on the device instead of each seek taking
+// its own synchronous page fault; on POSIX that still costs one madvise per merged range. Only the
+// first table whose range covers a key is read ahead, since the lookup may stop there; it is opened
+// if it isn't yet, which the lookup would do next anyway, so a cold batch right after OpenDB is
+// covered too. Blocks the block cache already holds decompressed are left alone.
+static void ReadAheadBatchBlocks(BedrockDB* db, const TableSet& set, const uint8_t* flatKeys, const int32_t* keyOffsets, const int32_t* keyLengths, int32_t count) {
+    const size_t tableCount = set.tables.size();
+    if (tableCount == 0 || db->options.disableReadAhead) return;
+    TraceSpan span("read ahead");
+    leveldb::Cache* blockCache = db->blockCache.get();
+    std::vector<MemoryRange> ranges;
+    std::vector<TableRef> pinned; // Keeps every range mapped until PrefetchMemory has returned
+    std::mutex rangesMutex;
+
+    ParallelForRanges(0, count, [&](int32_t tStart, int32_t tEnd) {
+        std::vector<MemoryRange> local;
+        std::vector<TableRef> refs(tableCount);
+        std::vector<uint8_t> failed(tableCount); // Couldn't be opened
+        size_t lastTable = SIZE_MAX;
+        uint64_t lastBegin = UINT64_MAX;
+        for (int32_t i = tStart; i < tEnd; ++i) {
+            std::string_view key(reinterpret_cast<const char*>(flatKeys + keyOffsets[i]), (size_t)keyLengths[i]);
+            if (set.chunkIndex && set.chunkIndex->Covers(key)) continue; // Answered without the tables
+            size_t ti = FirstCoveringTable(set, key);
+            if (ti == tableCount || failed[ti]) continue;
+            TableRef& ref = refs[ti];
+            if (!ref && !(ref = AcquireTable(db, *set.tables[ti]))) { failed[ti] = 1; continue; }
+            if (!ref->mapped) continue;
+
+            uint64_t begin, end;
+            if (ref->index.data) {
+                BlockHandle h;
+                if (!LocateDataBlock(*ref.get(), key, h)) continue;
+                begin = h.offset;
+                end = h.offset + h.size + kBlockTrailerSize;
+            } else {
+                begin = ref->table->ApproximateOffsetOf(leveldb::Slice(key.data(), key.size()));
+                end = begin + kColdBlockReadBytes;
+            }
+            if (begin >= ref->fileSize) continue;
+            if (ti == lastTable && begin == lastBegin) continue; // Neighbouring chunks usually share a block
+            lastTable = ti; lastBegin = begin;
+            if (ref->index.data) {
+                char cacheKey[16];
+                if (auto* cached = blockCache->Lookup(BlockCacheKey(cacheKey, ref->cacheId, begin))) {
+                    blockCache->Release(cached);
+                    continue;
+                }
+            }
+            uint64_t page = begin & ~(kPageSize - 1);
+            local.push_back({ const_cast<uint8_t*>(ref->mapped + page), (size_t)(std::min(end, ref->fileSize) - page) });
+        }
+        std::lock_guard<std::mutex> lock(rangesMutex);
+        ranges.insert(ranges.end(), local.begin(), local.end());
+        for (auto& ref : refs) if (ref) pinned.push_back(std::move(ref));
+        });
+    if (ranges.empty()) return;
+
+    std::sort(ranges.begin(), ranges.end(), [](auto const& a, auto const& b) { return a.address < b.address; });
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        auto& cur = ranges[merged];
+        uint8_t* curEnd = (uint8_t*)cur.address + cur.bytes;
+        uint8_t* nextStart = (uint8_t*)ranges[i].address;
+        uint8_t* nextEnd = nextStart + ranges[i].bytes;
+        // Only overlapping or touching ranges are coalesced, so every merged range stays mapped.
+        if (nextStart <= curEnd) { if (nextEnd > curEnd) cur.bytes = nextEnd - (uint8_t*)cur.address; }
+        else ranges[++merged] = ranges[i];
+    }
+    ranges.resize(merged + 1);
+
+    PrefetchMemory(ranges);
+}
+
+// Background half of Prefetch: reads the batch ahead like a lookup would, then decodes every block
+// the keys' first covering tables send them to into the block cache, so the lookups that follow
+// find them there instead of inflating them on the spot.
+static void WarmBatchBlocks(BedrockDB* db, const TableSet& set, const uint8_t* flatKeys, const int32_t* keyOffsets, const int32_t* keyLengths, int32_t count) {
+    const size_t tableCount = set.tables.size();
+    if (tableCount == 0) return;
+    ReadAheadBatchBlocks(db, set, flatKeys, keyOffsets, keyLengths, count);
+    TraceSpan span("warm blocks");
+
+    ParallelForRanges(0, count, [&](int32_t tStart, int32_t tEnd) {
+        std::vector<TableRef> refs(tableCount);
+        std::vector<uint8_t> failed(tableCount); // Couldn't be opened
+        size_t lastTable = SIZE_MAX;
+        uint64_t lastOffset = UINT64_MAX;
+        for (int32_t i = tStart; i < tEnd; ++i) {
+            std::string_view key(reinterpret_cast<const char*>(flatKeys + keyOffsets[i]), (size_t)keyLengths[i]);
+            if (set.chunkIndex && set.chunkIndex->Covers(key)) continue;
+            size_t ti = FirstCoveringTable(set, key);
+            if (ti == tableCount || failed[ti]) continue;
+            TableRef& ref = refs[ti];
+            if (!ref && !(ref = AcquireTable(db, *set.tables[ti]))) { failed[ti] = 1; continue; }
+            BlockHandle h;
+            if (!ref->mapped || !LocateDataBlock(*ref.get(), key, h)) continue;
+            if (ti == lastTable && h.offset == lastOffset) continue;
+            lastTable = ti; lastOffset = h.offset;
+            BlockRef block;
+            BlockView view;
+            ReadTableBlock(db, *ref.get(), h, block, view);
+        }
+        });
+}
+
+// CloseDB must not free the db under a background prefetch.
+static void WaitForPrefetch(BedrockDB* db) {
+    if (db->prefetchTask.valid()) db->prefetchTask.wait();
+}
+
+static bool StartPrefetch(BedrockDB* db, std::vector<uint8_t> flatKeys, std::vector<int32_t> keyOffsets, std::vector<int32_t> keyLengths) {
+    if (db->prefetchTask.valid() && db->prefetchTask.wait_for(0s) != std::future_status::ready) return false;
+    db->prefetchTask = std::async(std::launch::async, [db, flatKeys = std::move(flatKeys), keyOffsets = std::move(keyOffsets), keyLengths = std::move(keyLengths)]() {
+        auto set = db->current.load();
+        WarmBatchBlocks(db, *set, flatKeys.data(), keyOffsets.data(), keyLengths.data(), (int32_t)keyOffsets.size());
+        });
+    return true;
+}
+
+static size_t EncodeChunkKey(uint8_t* out, int32_t x, int32_t z, int32_t dim, uint8_t tag) {
+    memcpy(out, &x, 4); memcpy(out + 4, &z, 4);
+    size_t len = 8;
+    if (dim != 0) { memcpy(out + len, &dim, 4); len += 4; }
+    out[len++] = tag;
+    return len;
+}
+
+constexpr int64_t kMaxPrefetchChunks = 4096;
+
+static bool StartChunkRectPrefetch(BedrockDB* db, int32_t minX, int32_t minZ, int32_t maxX, int32_t maxZ, int32_t dim, uint8_t tag) {
+    if (!db || maxX < minX || maxZ < minZ) return false;
+    int64_t area = (int64_t(maxX) - minX + 1) * (int64_t(maxZ) - minZ + 1);
+    if (area > kMaxPrefetchChunks) return false;
+
+    std::vector<uint8_t> keys((size_t)area * 13);
+    std::vector<int32_t> offsets, lengths;
+    offsets.reserve((size_t)area); lengths.reserve((size_t)area);
+    size_t pos = 0;
+    for (int32_t x = minX; x <= maxX; ++x) {
+        for (int32_t z = minZ; z <= maxZ; ++z) {
+            size_t len = EncodeChunkKey(keys.data() + pos, x, z, dim, tag);
+            offsets.push_back((int32_t)pos); lengths.push_back((int32_t)len);
+            pos += len;
+        }
+    }
+    keys.resize(pos);
+    return StartPrefetch(db, std::move(keys), std::move(offsets), std::move(lengths));
+}
+
+constexpr int kLookupsInFlight = 8;
+constexpr size_t kBlockPrefetchBytes = 256;
+
+struct LookupSlot {
+    int32_t key = -1; // Batch index, -1 when the slot is idle
+    size_t table = 0; // Next table to probe
+    leveldb::Slice target;
+    TableRef pinned;  // Held from the prefetch until the probe of the same round
+    uint64_t traceStart = 0;
+    bool exhaustive = true; // Every candidate table could be searched, so a miss is worth a hint
+};
+
+// Runs keys [start, end) of a batch with several lookups in flight at once. Each round first
+// resolves every in-flight key to its data block in its next candidate table (the index block is
+// already resident) and prefetches that block, then comes back and does the actual seeks, so the
+// cache misses of different keys overlap instead of being paid one after another.
+template <typename KeyOps>
+static void InternalGetRangeToBuffers(BedrockDB* db, const TableSet& set, const uint8_t* flatKeys, const int32_t* keyOffsets, const int32_t* keyLengths,
+    int32_t start, int32_t end, TempResult* results, const StopToken& stop) {
+    const size_t tableCount = set.tables.size();
+    if (tableCount == 0) return;
+    ScopedTimer timer(kTimerBatchLookup);
+    TraceSpan span("lookup range");
+    const bool tracing = TraceEnabled();
+
+    LookupSlot slots[kLookupsInFlight];
+    int32_t next = start;
+    int active = 0;
+    uint64_t probed = 0, skipped = 0, copied = 0; // Flushed to the thread's stats once at the end
+    LocationHints* hints = db->hints.get();
+    const ChunkIndex* chunkIndex = set.chunkIndex.get();
+    uint64_t hintHits = 0;
+
+    auto refill = [&](LookupSlot& s) {
+        // A key's span runs from taking its slot to handing the slot on, across interleaved rounds.
+        if (tracing) {
+            uint64_t now = TraceNow();
+            if (s.key >= 0) EmitSpan("lookup key", s.traceStart, now);
+            s.traceStart = now;
+        }
+        for (; next < end; ++next) {
+            std::string_view key(reinterpret_cast<const char*>(flatKeys + keyOffsets[next]), (size_t)keyLengths[next]);
+            if (chunkIndex && chunkIndex->Lookup(key, results[next])) {
+                if (results[next].found) copied += results[next].data.size();
+                continue;
+            }
+            if (hints && LookupByHint(db, set, key, results[next])) {
+                ++hintHits;
+                if (results[next].found) copied += results[next].data.size();
+                continue;
+            }
+            s.key = next++; s.table = 0; s.exhaustive = true;
+            s.target = leveldb::Slice(key.data(), key.size());
+            return true;
+        }
+        s.key = -1;
+        return false;
+    };
+    for (auto& s : slots) if (refill(s)) ++active;
+
+    while (active > 0 && !stop.Stopped()) {
+        for (auto& s : slots) {
+            // Skip tables whose key range rules the key out; a key that runs out of tables is a
+            // miss and hands its slot to the next key.
+            while (s.key >= 0) {
+                std::string_view key(s.target.data(), s.target.size());
+                while (s.table < tableCount && !TableMayContain<KeyOps>(*set.tables[s.table], key)) { ++s.table; ++skipped; }
+                if (s.table < tableCount) {
+                    if ((s.pinned = AcquireTable(db, *set.tables[s.table]))) break;
+                    ++s.table;
+                    s.exhaustive = false;
+                    continue;
+                }
+                if (hints && s.exhaustive) hints->Store(key, set.generation, kHintNoTable, {});
+                if (!refill(s)) --active;
+            }
+            if (s.key < 0 || !s.pinned->mapped) continue;
+            uint64_t off = s.pinned->table->ApproximateOffsetOf(s.target);
+            if (off < s.pinned->fileSize) PrefetchRange(s.pinned->mapped + off, (size_t)std::min<uint64_t>(kBlockPrefetchBytes, s.pinned->fileSize - off));
+        }
+
+        for (auto& s : slots) {
+            if (s.key < 0) continue;
+            TempResult& r = results[s.key];
+            ValueLocation loc;
+            r.found = ProbeTable<KeyOps>(db, s.pinned.get(), s.target, r.data, hints ? &loc : nullptr);
+            if (r.found && loc.known && s.exhaustive) hints->Store(std::string_view(s.target.data(), s.target.size()), set.generation, (uint32_t)s.table, loc);
+            s.pinned.Reset();
+            ++s.table;
+            ++probed;
+            if (r.found) copied += r.data.size();
+            if (r.found && !refill(s)) --active;
+        }
+    }
+
+    CountStat(kStatKeysLookedUp, uint64_t(next - start));
+    if (hints) hints->Count(hintHits, uint64_t(next - start) - hintHits);
+    CountStat(kStatTablesProbed, probed);
+    CountStat(kStatTablesSkipped, skipped);
+    CountStat(kStatBytesCopied, copied);
+}
+
+template <typename KeyOps>
+static bool InternalGetFromSessionToBuffer(LogSession* session, const uint8_t* key, size_t keyLen, std::vector<uint8_t>& buffer) {
+    ScopedTimer timer(kTimerSessionLookup);
+    TraceSpan span("session key");
+    CountStat(kStatSessionKeys);
+    const uint8_t firstChar = key[0];
+    std::string_view keyView(reinterpret_cast<const char*>(key), keyLen);
+    for (auto& logPtr : session->logs) {
+        MappedLog* log = logPtr.get();
+        if (!log->view.data || log->view.size == 0) continue;
+
+        const uint8_t* const dataStart = log->view.data;
+        const uint8_t* const dataEnd = dataStart + log->view.size;
+        const uint8_t* p = dataStart;
+
+        while (p + keyLen <= dataEnd) {
+            const void* found = std::memchr(p, firstChar, dataEnd - p);
+            if (!found) break;
+            p = static_cast<const uint8_t*>(found);
+
+            if (p + keyLen > dataEnd) break;
+
+            if (KeyOps::Equal(std::string_view(reinterpret_cast<const char*>(p), keyLen), keyView)) {
+                const uint8_t* lookbackStart = (p >= dataStart + 5) ? (p - 5) : dataStart;
+                const uint8_t* h = p - 1;
+                bool validEntry = false;
+
+                while (h >= lookbackStart) {
+                    size_t consumed = 0;
+                    uint32_t kLen = ReadVarint32(h, consumed);
+                    if ((h + consumed) == p && kLen == keyLen) {
+                        const uint8_t* valPos = p + keyLen;
+                        if (valPos < dataEnd) {
+                            size_t consumedVal = 0;
+                            uint32_t valLen = ReadVarint32(valPos, consumedVal);
+                            if (consumedVal > 0 && consumedVal <= 5) {
+                                const uint8_t* valStart = valPos + consumedVal;
+                                if (valStart + valLen <= dataEnd && (!session->verifyChecksums ||
+                                    LogSpanIntact(dataStart, log->view.size, uint64_t(h - dataStart), uint64_t(valStart + valLen - dataStart)))) {
+                                    buffer.assign(valStart, valStart + valLen);
+                                    CountStat(kStatBytesCopied, valLen);
+                                    return true;
+                                }
+                            }
+                        }
+                    }
+                    h--;
+                }
+            }
+            p++;
+        }
+    }
+    return false;
+}
+
+// Iteration Support Structures
+typedef void (*DBIterateCallback)(const uint8_t* key, int32_t keyLen, const uint8_t* val, int32_t valLen);
+typedef void (*BatchWaveCallback)(int32_t start, int32_t count, const uint8_t* dataBlock, const int32_t* dataOffsets, const int32_t* dataLengths, const uint8_t* found);
+
+struct IterWrapper {
+    leveldb::Iterator* iter;
+    size_t tableIndex; // Lower index = Newer table (Higher priority)
+    std::string_view userKey;
+
+    IterWrapper(leveldb::Iterator* it, size_t idx) : iter(it), tableIndex(idx) {
+        Update();
+    }
+
+    void Update() {
+        if (iter && iter->Valid()) {
+            leveldb::Slice k = iter->key();
+            // Internal keys have 8 bytes trailer (SeqNum + Type)
+            if (k.size() >= 8) {
+                userKey = std::string_view(k.data(), k.size() - 8);
+            }
+            else {
+                userKey = std::string_view(k.data(), k.size());
+            }
+        }
+        else {
+            userKey = {};
+        }
+    }
+};
+
+template <typename KeyOps>
+struct IterCompare {
+    bool operator()(const IterWrapper* a, const IterWrapper* b) {
+        // Min-Heap logic: Return true if a > b.
+        // We want smallest user key first.
+        int cmp = KeyOps::Compare(a->userKey, b->userKey);
+        if (cmp != 0) return cmp > 0;
+
+        // If keys are equal, we want the NEWER table (Smaller Index) to come first.
+        // In Min-Heap, "Smaller" pops first.
+        // So if IndexA > IndexB, A is "Larger" (worse), so return true.
+        return a->tableIndex > b->tableIndex;
+    }
+};
+
+template <typename KeyOps, typename Callback>
+static void MergeIterate(std::vector<IterWrapper>& wrappers, std::string_view prefixView, std::string_view suffixView, Callback&& callback, const StopToken& stop) {
+    TraceSpan span("merge iterate");
+    // 2. Priority Queue for Merging
+    std::priority_queue<IterWrapper*, std::vector<IterWrapper*>, IterCompare<KeyOps>> pq;
+    for (auto& w : wrappers) {
+        if (w.iter->Valid()) pq.push(&w);
+    }
+
+    std::string lastUserKey;
+    bool first = true;
+    uint32_t steps = 0;
+
+    while (!pq.empty()) {
+        if ((++steps & 63) == 0 && stop.Stopped()) break;
+        IterWrapper* top = pq.top();
+        pq.pop();
+
+        // 3. Process Key
+        std::string_view currentKey = top->userKey;
+
+        // Check Prefix (optimization: if sorted key doesn't start with prefix, we are done)
+        if (!prefixView.empty()) {
+            if (currentKey.size() < prefixView.size() ||
+                currentKey.substr(0, prefixView.size()) != prefixView) {
+                // Since keys are sorted, any subsequent key will also not match
+                break;
+            }
+        }
+
+        // Check Duplicates (Shadowing)
+        // Since tables are sorted by age (index 0 = newest), the first time we see a key, it is the newest version.
+        bool isNewKey = first || !KeyOps::Equal(currentKey, lastUserKey);
+
+        if (isNewKey) {
+            first = false;
+            lastUserKey = std::string(currentKey);
+
+            // Check Type (last byte of internal key usually)
+            // We need to look at the internal key to see if it's a deletion.
+            // Internal Key: [User Key][Trailer(8b)]
+            // Trailer is (Seq << 8) | Type
+            // In Little Endian (EncodeFixed64), the first byte of the trailer is the Type.
+            leveldb::Slice raw = top->iter->key();
+            uint8_t type = 0;
+
+            if (raw.size() >= 8) {
+                // Get the byte at offset (size - 8)
+                type = (uint8_t)raw.data()[raw.size() - 8];
+            }
+
+            // kTypeDeletion = 0x0, kTypeValue = 0x1
+            // If type is 0 (Deletion), we skip callback (it's deleted).
+
+            if (type == 0x1) {
+                // Check Suffix
+                bool suffixMatch = true;
+                if (!suffixView.empty()) {
+                    if (currentKey.size() < suffixView.size() ||
+                        currentKey.substr(currentKey.size() - suffixView.size()) != suffixView) {
+                        suffixMatch = false;
+                    }
+                }
+
+                if (suffixMatch) {
+                    CountStat(kStatKeysIterated);
+                    leveldb::Slice v = top->iter->value();
+                    callback(
+                        (const uint8_t*)currentKey.data(), (int32_t)currentKey.size(),
+                        (const uint8_t*)v.data(), (int32_t)v.size()
+                    );
+                }
+            }
+        }
+
+        // 4. Advance Iterator
+        top->iter->Next();
+        top->Update();
+        if (top->iter->Valid()) {
+            pq.push(top);
+        }
+    }
+}
+
+// Merges every table that can hold keys with the given prefix and calls
+// callback(key, keyLen, value, valueLen) for the newest live version of each matching key.
+template <typename Callback>
+static void IterateTables(BedrockDB* db, const TableSet& set, std::string_view prefixView, std::string_view suffixView, Callback&& callback, const StopToken& stop) {
+    ScopedTimer timer(kTimerIterate);
+    // 1. Create iterators for all tables whose key range can hold the prefix.
+    // Tables stay pinned in the table cache until their iterators are gone.
+    std::vector<TableRef> pinned;
+    std::vector<std::unique_ptr<leveldb::Iterator>> ownerVec;
+    std::vector<IterWrapper> wrappers;
+    pinned.reserve(set.tables.size());
+    ownerVec.reserve(set.tables.size());
+    wrappers.reserve(set.tables.size());
+
+    for (size_t i = 0; i < set.tables.size(); ++i) {
+        if (!TableMayContainPrefix(*set.tables[i], prefixView)) continue;
+        TableRef ref = AcquireTable(db, *set.tables[i]);
+        if (!ref) continue;
+        auto* it = ref->table->NewIterator(db->readOptions);
+        ownerVec.emplace_back(it);
+        pinned.push_back(std::move(ref));
+
+        if (!prefixView.empty()) {
+            it->Seek(leveldb::Slice(prefixView.data(), prefixView.size()));
+        }
+        else {
+            it->SeekToFirst();
+        }
+
+        if (it->Valid()) {
+            wrappers.emplace_back(it, i);
+        }
+    }
+
+    // A chunk prefix (x, z[, dim]) means the merge is mostly comparing fixed-width chunk keys.
+    KeyKind kind = prefixView.size() == 8 ? KeyKind::Chunk9 : prefixView.size() == 12 ? KeyKind::Chunk13 : KeyKind::Generic;
+    WithKeyOps(kind, [&](auto ops) { MergeIterate<decltype(ops)>(wrappers, prefixView, suffixView, callback, stop); });
+}
+
+// Lays keys out as a chunk index: fills in hdr's hash parameters, pilots, remap, and slots (keys
+// in their final order). Only fails if no seed separates the keys.
+static bool PlaceChunkKeys(const std::vector<ChunkIndexSlot>& keys, ChunkIndexHeader& hdr, std::vector<uint32_t>& pilots, std::vector<uint32_t>& remap, std::vector<ChunkIndexSlot>& slots) {
+    hdr.keyCount = keys.size();
+    hdr.tableSize = std::max<uint64_t>(hdr.keyCount, (uint64_t)std::ceil(hdr.keyCount / kChunkIndexLoadFactor));
+    hdr.bucketCount = 0;
+    if (hdr.tableSize > UINT32_MAX) return false;
+    if (hdr.keyCount) hdr.bucketCount = std::max<uint64_t>(2, (uint64_t)std::ceil(kChunkIndexBucketFactor * hdr.keyCount / std::max(1.0, std::log2((double)hdr.keyCount))));
+
+    pilots.assign(hdr.bucketCount, 0);
+    remap.assign(hdr.tableSize - hdr.keyCount, 0);
+    slots.assign(hdr.keyCount, {});
+    std::vector<uint64_t> hashes(hdr.keyCount), positions(hdr.keyCount);
+    std::vector<uint32_t> bucketStart(hdr.bucketCount + 1), order(hdr.keyCount), buckets(hdr.bucketCount);
+    std::vector<uint64_t> taken((hdr.tableSize + 63) / 64);
+    auto isTaken = [&](uint64_t pos) { return (taken[pos >> 6] >> (pos & 63) & 1) != 0; };
+
+    bool placed = hdr.keyCount == 0;
+    for (int attempt = 0; attempt < kChunkIndexMaxSeeds && !placed; ++attempt) {
+        hdr.seed = Mix64(uint64_t(attempt) + 1);
+        // Group the keys by bucket, then place the buckets largest first.
+        std::fill(bucketStart.begin(), bucketStart.end(), 0);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            hashes[i] = ChunkIndexHash(std::string_view(reinterpret_cast<const char*>(keys[i].key), keys[i].keyLen), hdr.seed);
+            ++bucketStart[ChunkIndexBucket(hashes[i], hdr.bucketCount) + 1];
+        }
+        for (size_t b = 0; b < hdr.bucketCount; ++b) bucketStart[b + 1] += bucketStart[b];
+        std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+        for (size_t i = 0; i < keys.size(); ++i) order[fill[ChunkIndexBucket(hashes[i], hdr.bucketCount)]++] = (uint32_t)i;
+        for (size_t b = 0; b < hdr.bucketCount; ++b) buckets[b] = (uint32_t)b;
+        std::stable_sort(buckets.begin(), buckets.end(), [&](uint32_t a, uint32_t b) {
+            return bucketStart[a + 1] - bucketStart[a] > bucketStart[b + 1] - bucketStart[b];
+            });
+
+        std::fill(taken.begin(), taken.end(), 0);
+        placed = true;
+        for (uint32_t b : buckets) {
+            const uint32_t first = bucketStart[b], last = bucketStart[b + 1];
+            if (first == last) break;
+            uint32_t pilot = 0;
+            for (; pilot < kChunkIndexMaxPilot; ++pilot) {
+                bool free = true;
+                for (uint32_t k = first; k < last && free; ++k) {
+                    uint64_t pos = ChunkIndexPosition(hashes[order[k]], pilot, hdr.tableSize);
+                    free = !isTaken(pos);
+                    for (uint32_t j = first; j < k && free; ++j) free = positions[order[j]] != pos;
+                    positions[order[k]] = pos;
+                }
+                if (free) break;
+            }
+            // Also where two keys share a full hash: no pilot separates them, but another seed will.
+            if (pilot == kChunkIndexMaxPilot) { placed = false; break; }
+            pilots[b] = pilot;
+            for (uint32_t k = first; k < last; ++k) taken[positions[order[k]] >> 6] |= uint64_t(1) << (positions[order[k]] & 63);
+        }
+    }
+    if (!placed) return false;
+
+    // Fold the positions past keyCount onto the holes below it.
+    uint64_t hole = 0;
+    for (uint64_t pos = hdr.keyCount; pos < hdr.tableSize; ++pos) {
+        if (!isTaken(pos)) continue;
+        while (isTaken(hole)) ++hole;
+        remap[pos - hdr.keyCount] = (uint32_t)hole++;
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        uint64_t pos = positions[i];
+        slots[pos < hdr.keyCount ? pos : remap[pos - hdr.keyCount]] = keys[i];
+    }
+    return true;
+}
+
+// Written next to the target and renamed over it, like the metadata sidecar.
+static bool SaveChunkIndex(const std::string& outPath, ChunkIndexHeader& hdr, const std::vector<uint32_t>& pilots, const std::vector<uint32_t>& remap,
+    const std::vector<ChunkIndexSlot>& slots, const std::vector<uint8_t>& values) {
+    memcpy(hdr.magic, kChunkIndexMagic, sizeof(hdr.magic));
+    hdr.version = kChunkIndexVersion;
+    hdr.pilotsOffset = sizeof(hdr);
+    hdr.remapOffset = hdr.pilotsOffset + pilots.size() * sizeof(uint32_t);
+    uint64_t remapEnd = hdr.remapOffset + remap.size() * sizeof(uint32_t);
+    hdr.slotsOffset = (remapEnd + 7) & ~uint64_t(7);
+    hdr.valuesOffset = hdr.slotsOffset + slots.size() * sizeof(ChunkIndexSlot);
+    hdr.valuesBytes = values.size();
+
+    std::string tmpPath = outPath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        static const char zeros[8] = {};
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(reinterpret_cast<const char*>(pilots.data()), pilots.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(remap.data()), remap.size() * sizeof(uint32_t));
+        out.write(zeros, hdr.slotsOffset - remapEnd);
+        out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(ChunkIndexSlot));
+        out.write(reinterpret_cast<const char*>(values.data()), values.size());
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, outPath, ec);
+    return !ec;
+}
+
+// Builds the chunk index for tag over db's tables and writes it to outPath. Values go in key order,
+// so neighbouring chunks' records end up next to each other in the file. Returns the number of
+// keys indexed, or -1.
+static int64_t WriteChunkIndex(BedrockDB* db, uint8_t tag, const std::string& outPath) {
+    TraceSpan span("build chunk index");
+    auto set = db->current.load();
+    std::vector<ChunkIndexSlot> keys;
+    std::vector<uint8_t> values;
+    StopToken stop;
+    IterateTables(db, *set, {}, {}, [&](const uint8_t* key, int32_t keyLen, const uint8_t* val, int32_t valLen) {
+        if (!IsChunkKeyOfTag(std::string_view(reinterpret_cast<const char*>(key), (size_t)keyLen), tag)) return;
+        ChunkIndexSlot slot{};
+        memcpy(slot.key, key, (size_t)keyLen);
+        slot.keyLen = (uint32_t)keyLen;
+        slot.valueOffset = values.size();
+        slot.valueLen = (uint32_t)valLen;
+        values.insert(values.end(), val, val + valLen);
+        keys.push_back(slot);
+        }, stop);
+
+    ChunkIndexHeader hdr{};
+    hdr.tag = tag;
+    hdr.fingerprint = FingerprintTables(*set);
+    std::vector<uint32_t> pilots, remap;
+    std::vector<ChunkIndexSlot> slots;
+    if (!PlaceChunkKeys(keys, hdr, pilots, remap, slots) || !SaveChunkIndex(outPath, hdr, pilots, remap, slots, values)) return -1;
+    return (int64_t)hdr.keyCount;
+}
+
+// Render result ring
 
-    uint64_t size = 0; std::error_code ec;
-    size = static_cast<uint64_t>(std::filesystem::file_size(fullPath, ec));
-    if (ec) { delete file; return nullptr; }
+// Mirrors LevelDBMinimal.RenderBox; only ever append fields.
+struct RenderBox {
+    int32_t minX, minY, minZ;
+    int32_t maxX, maxY, maxZ;
+    uint32_t flags;
+};
+constexpr uint32_t kBoxFull = 1;    // Volume marked full in its structure data
+constexpr uint32_t kBoxVillage = 2; // Village bounds from a VILLAGE_*_INFO record
 
-    leveldb::Options opts; opts.compression = leveldb::kNoCompression;
-    leveldb::Table* table = nullptr;
-    if (!leveldb::Table::Open(opts, file, size, &table).ok()) {
-        delete file; return nullptr;
-    }
+// Mirrors LevelDBMinimal.ResultFrame; only ever append fields.
+struct ResultFrame {
+    uint64_t generation; // 0 until the first publish
+    RenderBox* boxes;
+    int32_t count;
+    int32_t capacity;
+    uint32_t truncated;  // Non-zero when more boxes were found than fit
+    int32_t centerX, centerZ, dim; // The query this frame answers
+    uint32_t complete;   // Zero while the query is still streaming in further rings
+};
 
-    auto t = std::make_unique<SSTable>();
-    t->path = fullPath; t->fileSize = size; t->file = file; t->table = table;
-    return t;
+struct ChunkPosition { int32_t x, z, dim; };
+
+constexpr uint32_t kFrameFresh = 4; // Set in ResultRing::shared when the traded frame is unread
+
+// Triple buffer between one writer (a box query) and one reader (the render thread). Each side
+// owns a frame and they trade through the third with a single atomic exchange, so neither side
+// ever waits for or copies from the other, and the reader always sees the newest complete frame.
+struct ResultRing {
+    PageBuffer storage; // The three frames' boxes, back to back
+    ResultFrame frames[3] = {};
+    std::atomic<uint32_t> shared = 1; // Traded frame index | kFrameFresh
+    uint32_t back = 0;  // Writer's frame
+    uint32_t front = 2; // Reader's frame
+    uint64_t sequence = 0; // Writer only
+    std::optional<ChunkPosition> lastComplete; // Writer only; centre of the last complete frame
+
+    ~ResultRing() { FreePageBuffer(storage); }
+};
+
+static ResultFrame& BeginFrame(ResultRing* ring) {
+    ResultFrame& f = ring->frames[ring->back];
+    f.count = 0; f.truncated = 0;
+    return f;
 }
 
-static void CloseSingleLog(MappedLog* log) {
-    if (!log) return;
-    if (log->data) { UnmapViewOfFile(log->data); log->data = nullptr; }
-    if (log->hMap) { CloseHandle(log->hMap); log->hMap = NULL; }
-    if (log->hFile != INVALID_HANDLE_VALUE) { CloseHandle(log->hFile); log->hFile = INVALID_HANDLE_VALUE; }
-    log->mappedSize = 0;
+static void PublishFrame(ResultRing* ring) {
+    ring->frames[ring->back].generation = ++ring->sequence;
+    ring->back = ring->shared.exchange(ring->back | kFrameFresh, std::memory_order_acq_rel) & 3;
 }
 
-static bool RemapLogIfNeeded(MappedLog* log) {
-    if (!log || log->hFile == INVALID_HANDLE_VALUE) return false;
-    LARGE_INTEGER sz;
-    if (!GetFileSizeEx(log->hFile, &sz)) { CloseSingleLog(log); return false; }
-    uint64_t currentOnDiskSize = static_cast<uint64_t>(sz.QuadPart);
-    if (currentOnDiskSize == 0) { CloseSingleLog(log); return false; }
-    if (currentOnDiskSize == log->mappedSize) return true;
+static const ResultFrame* AcquireFrame(ResultRing* ring) {
+    if (ring->shared.load(std::memory_order_relaxed) & kFrameFresh)
+        ring->front = ring->shared.exchange(ring->front, std::memory_order_acq_rel) & 3;
+    return &ring->frames[ring->front];
+}
 
-    if (log->data) { UnmapViewOfFile(log->data); if (log->hMap) CloseHandle(log->hMap); log->hMap = NULL; log->data = nullptr; }
-    log->hMap = CreateFileMappingA(log->hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
-    if (!log->hMap) return false;
-    log->data = (uint8_t*)MapViewOfFile(log->hMap, FILE_MAP_READ, 0, 0, 0);
-    if (!log->data) { CloseHandle(log->hMap); log->hMap = NULL; return false; }
-    log->mappedSize = currentOnDiskSize; return true;
+// Publishes boxes as the answer to the query around (cx, cz), cut to the ring's frame capacity.
+static void PublishBoxes(ResultRing* ring, const std::vector<RenderBox>& boxes, int32_t cx, int32_t cz, int32_t dim, bool complete) {
+    ResultFrame& f = BeginFrame(ring);
+    f.count = (int32_t)std::min<size_t>(boxes.size(), (size_t)f.capacity);
+    f.truncated = boxes.size() > (size_t)f.capacity;
+    std::copy_n(boxes.begin(), f.count, f.boxes);
+    f.centerX = cx; f.centerZ = cz; f.dim = dim;
+    f.complete = complete;
+    PublishFrame(ring);
+    if (complete) ring->lastComplete = ChunkPosition{ cx, cz, dim };
 }
 
-struct IteratorCache {
-    std::vector<leveldb::Iterator*> iterators;
-    ~IteratorCache() { for (auto* it : iterators) delete it; }
-};
+// Native port of Parser.ParseAABBVolumes: the volumes of one chunk's AABB record, deduplicated by
+// id, with the full flag taken from the matching static entry.
+static void ParseAABBVolumes(const uint8_t* p, size_t size, std::vector<RenderBox>& out) {
+    constexpr int32_t kMaxVolumes = 50;
+    const uint8_t* end = p + size;
+    auto readInt = [&](int32_t& v) {
+        if (end - p < 4) return false;
+        memcpy(&v, p, 4); p += 4;
+        return true;
+    };
 
-static thread_local IteratorCache t_iterCache;
+    int32_t version, structCount;
+    if (!readInt(version) || !readInt(structCount)) return;
+    for (int32_t i = 0; i < structCount; ++i) {
+        if (end - p < 6) return;
+        uint16_t strLen; memcpy(&strLen, p + 4, 2); p += 6;
+        if (end - p < strLen) return;
+        p += strLen;
+    }
 
-static void EnsureIterators(BedrockDB* db) {
-    if (t_iterCache.iterators.size() < db->tables.size()) {
-        t_iterCache.iterators.reserve(db->tables.size());
-        for (size_t i = t_iterCache.iterators.size(); i < db->tables.size(); ++i) {
-            t_iterCache.iterators.push_back(db->tables[i]->table->NewIterator(db->readOptions));
+    int32_t aabbCount;
+    if (!readInt(aabbCount) || aabbCount > kMaxVolumes) return;
+    RenderBox boxes[kMaxVolumes];
+    uint32_t seen[kMaxVolumes];
+    int32_t boxCount = 0;
+    for (int32_t i = 0; i < aabbCount; ++i) {
+        if (end - p < 28) return;
+        uint32_t id; memcpy(&id, p, 4);
+        if (std::find(seen, seen + boxCount, id) == seen + boxCount) {
+            int32_t v[6]; memcpy(v, p + 4, sizeof(v));
+            seen[boxCount] = id;
+            boxes[boxCount++] = { v[0], v[1], v[2], v[3], v[4], v[5], 0 };
         }
+        p += 28;
     }
-    else if (t_iterCache.iterators.size() > db->tables.size()) {
-        for (size_t i = db->tables.size(); i < t_iterCache.iterators.size(); ++i) {
-            delete t_iterCache.iterators[i];
+
+    int32_t dynCount;
+    if (!readInt(dynCount) || dynCount < 0 || end - p < int64_t(dynCount) * 12) return;
+    p += size_t(dynCount) * 12;
+
+    int32_t statCount;
+    if (!readInt(statCount) || statCount > kMaxVolumes) return;
+    uint32_t statSeen[kMaxVolumes];
+    int32_t statSeenCount = 0, next = 0;
+    for (int32_t i = 0; i < statCount; ++i) {
+        if (end - p < 16) return;
+        uint32_t id; int32_t full;
+        memcpy(&id, p, 4); memcpy(&full, p + 12, 4); p += 16;
+        if (std::find(statSeen, statSeen + statSeenCount, id) != statSeen + statSeenCount) continue;
+        statSeen[statSeenCount++] = id;
+        if (next < boxCount) {
+            boxes[next].flags = full ? kBoxFull : 0;
+            out.push_back(boxes[next++]);
         }
-        t_iterCache.iterators.resize(db->tables.size());
     }
+    while (next < boxCount) out.push_back(boxes[next++]);
 }
 
-static bool InternalGetToBuffer(BedrockDB* db, const uint8_t* key, size_t keyLen, std::vector<uint8_t>& buffer) {
-    EnsureIterators(db);
-    leveldb::Slice target(reinterpret_cast<const char*>(key), keyLen);
+// Native port of Parser.ParseVillageInfo: X0/Y0/Z0/X1/Y1/Z1 from the root compound.
+static void ParseVillageInfo(const uint8_t* p, size_t size, std::vector<RenderBox>& out) {
+    if (size < 8 || p[0] != 0x0A) return;
+    const uint8_t* end = p + size;
+    p += 3;
 
-    for (size_t i = 0; i < db->tables.size(); ++i) {
-        leveldb::Iterator* it = t_iterCache.iterators[i];
-        if (!it) continue;
+    int32_t v[6] = {};
+    uint32_t got = 0;
+    while (p < end) {
+        uint8_t tag = *p++;
+        if (tag == 0 || end - p < 2) return;
+        uint16_t nameLen; memcpy(&nameLen, p, 2); p += 2;
+        if (end - p < nameLen) return;
+        const uint8_t* name = p;
+        p += nameLen;
 
-        it->Seek(target);
-        if (!it->Valid()) continue;
-
-        leveldb::Slice raw = it->key();
-        size_t rawSize = raw.size();
-        size_t userSize = rawSize > 8 ? rawSize - 8 : rawSize;
+        if (nameLen == 2) {
+            if (end - p < 4) return;
+            int axis = name[0] == 'X' ? 0 : name[0] == 'Y' ? 1 : name[0] == 'Z' ? 2 : -1;
+            if (tag == 0x03 && axis >= 0 && (name[1] == '0' || name[1] == '1')) {
+                int slot = axis + (name[1] == '1' ? 3 : 0);
+                memcpy(&v[slot], p, 4);
+                got |= 1u << slot;
+            }
+            p += 4;
+        }
+        else {
+            switch (tag) {
+            case 1: p += 1; break;
+            case 2: p += 2; break;
+            case 3: case 5: p += 4; break;
+            case 4: case 6: p += 8; break;
+            case 7: {
+                if (end - p < 4) return;
+                int32_t len; memcpy(&len, p, 4);
+                if (len < 0) return;
+                p += 4 + size_t(len);
+                break;
+            }
+            case 8: {
+                if (end - p < 2) return;
+                uint16_t len; memcpy(&len, p, 2);
+                p += 2 + size_t(len);
+                break;
+            }
+            default: return; // Lists and nested compounds come after the bounds
+            }
+        }
 
-        if (userSize == keyLen && memcmp(raw.data(), key, keyLen) == 0) {
-            leveldb::Slice v = it->value();
-            buffer.assign((const uint8_t*)v.data(), (const uint8_t*)v.data() + v.size());
-            return true;
+        if (got == 0x3F) {
+            out.push_back({ v[0], v[1], v[2], v[3], v[4], v[5], kBoxVillage });
+            return;
         }
     }
-    return false;
 }
 
-static bool InternalGetFromSessionToBuffer(LogSession* session, const uint8_t* key, size_t keyLen, std::vector<uint8_t>& buffer) {
-    const uint8_t firstChar = key[0];
-    for (auto& logPtr : session->logs) {
-        MappedLog* log = logPtr.get();
-        if (!log->data || log->mappedSize == 0) continue;
-
-        const uint8_t* const dataStart = log->data;
-        const uint8_t* const dataEnd = dataStart + log->mappedSize;
-        const uint8_t* p = dataStart;
-
-        while (p + keyLen <= dataEnd) {
-            const void* found = std::memchr(p, firstChar, dataEnd - p);
-            if (!found) break;
-            p = static_cast<const uint8_t*>(found);
-
-            if (p + keyLen > dataEnd) break;
+constexpr uint8_t kAABBVolumesTag = 0x77;
+constexpr int32_t kMaxQueryRadius = 31;
 
-            if (memcmp(p, key, keyLen) == 0) {
-                const uint8_t* lookbackStart = (p >= dataStart + 5) ? (p - 5) : dataStart;
-                const uint8_t* h = p - 1;
-                bool validEntry = false;
+constexpr int32_t kMinWaveKeys = 24;
 
-                while (h >= lookbackStart) {
-                    size_t consumed = 0;
-                    uint32_t kLen = ReadVarint32(h, consumed);
-                    if ((h + consumed) == p && kLen == keyLen) {
-                        const uint8_t* valPos = p + keyLen;
-                        if (valPos < dataEnd) {
-                            size_t consumedVal = 0;
-                            uint32_t valLen = ReadVarint32(valPos, consumedVal);
-                            if (consumedVal > 0 && consumedVal <= 5) {
-                                const uint8_t* valStart = valPos + consumedVal;
-                                if (valStart + valLen <= dataEnd) {
-                                    buffer.assign(valStart, valStart + valLen);
-                                    return true;
-                                }
-                            }
-                        }
-                    }
-                    h--;
-                }
-            }
-            p++;
-        }
+// Chunk offsets within radius, ring by ring outwards from the centre, and the end of each wave:
+// consecutive rings grouped until a wave holds at least kMinWaveKeys keys.
+static void SpiralOrder(int32_t radius, std::vector<std::pair<int32_t, int32_t>>& cells, std::vector<int32_t>& waveEnds) {
+    cells.assign(1, { 0, 0 });
+    waveEnds.clear();
+    for (int32_t d = 1; d <= radius; ++d) {
+        for (int32_t i = -d; i < d; ++i) cells.emplace_back(i, -d);
+        for (int32_t i = -d; i < d; ++i) cells.emplace_back(d, i);
+        for (int32_t i = d; i > -d; --i) cells.emplace_back(i, d);
+        for (int32_t i = d; i > -d; --i) cells.emplace_back(-d, i);
+        if ((int32_t)cells.size() - (waveEnds.empty() ? 0 : waveEnds.back()) >= kMinWaveKeys) waveEnds.push_back((int32_t)cells.size());
     }
-    return false;
+    if (waveEnds.empty() || waveEnds.back() != (int32_t)cells.size()) waveEnds.push_back((int32_t)cells.size());
 }
 
-// Iteration Support Structures
-typedef void (*DBIterateCallback)(const uint8_t* key, int32_t keyLen, const uint8_t* val, int32_t valLen);
-
-struct IterWrapper {
-    leveldb::Iterator* iter;
-    size_t tableIndex; // Lower index = Newer table (Higher priority)
-    std::string_view userKey;
+// Looks up the AABB volumes of every chunk within radius of (cx, cz), falls back to the log
+// session for chunks not yet written to a table, adds the village bounds and publishes the lot.
+// Chunks are looked up nearest first, wave by wave. When the last complete frame doesn't overlap
+// this query (first query, teleport, dimension change) every wave is published as it lands, so the
+// nearest boxes show up before the far rings finish; otherwise the old frame is still mostly right
+// and only the complete answer is published, so far boxes don't blink out. A stopped query
+// publishes nothing further. One writer per ring.
+static void RunBoxQuery(BedrockDB* db, LogSession* session, int32_t cx, int32_t cz, int32_t radius, int32_t dim, ResultRing* ring, const StopToken& stop) {
+    TraceSpan span("box query");
+    std::vector<std::pair<int32_t, int32_t>> cells;
+    std::vector<int32_t> waveEnds;
+    SpiralOrder(radius, cells, waveEnds);
 
-    IterWrapper(leveldb::Iterator* it, size_t idx) : iter(it), tableIndex(idx) {
-        Update();
+    const int32_t count = (int32_t)cells.size();
+    std::vector<uint8_t> keys(size_t(count) * 13);
+    std::vector<int32_t> offsets(count), lengths(count);
+    size_t pos = 0;
+    for (int32_t n = 0; n < count; ++n) {
+        lengths[n] = (int32_t)EncodeChunkKey(keys.data() + pos, cx + cells[n].first, cz + cells[n].second, dim, kAABBVolumesTag);
+        offsets[n] = (int32_t)pos;
+        pos += lengths[n];
     }
 
-    void Update() {
-        if (iter && iter->Valid()) {
-            leveldb::Slice k = iter->key();
-            // Internal keys have 8 bytes trailer (SeqNum + Type)
-            if (k.size() >= 8) {
-                userKey = std::string_view(k.data(), k.size() - 8);
+    const auto& last = ring->lastComplete;
+    bool stream = !last || last->dim != dim || std::max(std::abs(last->x - cx), std::abs(last->z - cz)) > radius;
+
+    std::vector<TempResult> results(count);
+    std::vector<RenderBox> boxes;
+    auto set = db->current.load();
+    WithKeyOps(dim != 0 ? KeyKind::Chunk13 : KeyKind::Chunk9, [&](auto ops) {
+        using KeyOps = decltype(ops);
+        int32_t waveStart = 0;
+        for (int32_t waveEnd : waveEnds) {
+            ReadAheadBatchBlocks(db, *set, keys.data(), offsets.data() + waveStart, lengths.data() + waveStart, waveEnd - waveStart);
+            ParallelForRanges(waveStart, waveEnd, [&](int tStart, int tEnd) {
+                InternalGetRangeToBuffers<KeyOps>(db, *set, keys.data(), offsets.data(), lengths.data(), tStart, tEnd, results.data(), stop);
+                });
+            if (session) {
+                ParallelFor(waveStart, waveEnd, [&](int i) {
+                    if (!results[i].found && !stop.Stopped()) results[i].found = InternalGetFromSessionToBuffer<KeyOps>(session, keys.data() + offsets[i], (size_t)lengths[i], results[i].data);
+                    });
             }
-            else {
-                userKey = std::string_view(k.data(), k.size());
+            for (int32_t i = waveStart; i < waveEnd; ++i) {
+                if (results[i].found && !results[i].data.empty()) ParseAABBVolumes(results[i].data.data(), results[i].data.size(), boxes);
             }
+            if (stop.Stopped()) return;
+            if (stream && waveEnd < count) PublishBoxes(ring, boxes, cx, cz, dim, false);
+            waveStart = waveEnd;
         }
-        else {
-            userKey = {};
-        }
-    }
-};
-
-struct IterCompare {
-    bool operator()(const IterWrapper* a, const IterWrapper* b) {
-        // Min-Heap logic: Return true if a > b.
-        // We want smallest user key first.
-        int cmp = a->userKey.compare(b->userKey);
-        if (cmp != 0) return cmp > 0;
+        });
+    if (stop.Stopped()) return;
 
-        // If keys are equal, we want the NEWER table (Smaller Index) to come first.
-        // In Min-Heap, "Smaller" pops first.
-        // So if IndexA > IndexB, A is "Larger" (worse), so return true.
-        return a->tableIndex > b->tableIndex;
-    }
-};
+    IterateTables(db, *set, "VILLAGE", "INFO", [&](const uint8_t*, int32_t, const uint8_t* val, int32_t valLen) {
+        ParseVillageInfo(val, (size_t)valLen, boxes);
+        }, stop);
+    if (!stop.Stopped()) PublishBoxes(ring, boxes, cx, cz, dim, true);
+}
 
 extern "C" {
-    EXPORT BedrockDB* OpenDB(const char* path) {
+    EXPORT BedrockDB* OpenDBWithOptions(const char* path, const DBOptions* options) {
+        CallRecord rec(kRecOpenDB);
+        rec.Str(path);
+        rec.Int(options ? options->maxOpenTables : 0);
+        rec.Int(options ? options->preopenTables : 0);
+        rec.Int(options ? options->verifyChecksums : 0);
+        rec.Int(options ? options->blockCacheBytes : 0);
+        rec.Int(options ? options->secondaryCacheBytes : 0);
+        rec.Int(options ? options->locationHints : 0);
+        rec.Str(options ? options->snapshotPath : nullptr);
+        rec.Str(options ? options->chunkIndexPath : nullptr);
+        rec.Int(options ? options->disableReadAhead : 0);
         if (!path) return nullptr;
+        ScopedTimer timer(kTimerOpenDB);
+        TraceSpan span("OpenDB");
         std::error_code ec; std::filesystem::path dir(path);
         if (!std::filesystem::exists(dir, ec) || !std::filesystem::is_directory(dir, ec)) return nullptr;
         auto db = new BedrockDB();
+        db->dir = dir;
+        if (options) db->options = *options;
+        if (db->options.snapshotPath) db->snapshotPath = db->options.snapshotPath;
+        db->options.snapshotPath = nullptr; // Host-owned string, don't keep it past this call
+        std::string chunkIndexPath = db->options.chunkIndexPath ? db->options.chunkIndexPath : "";
+        db->options.chunkIndexPath = nullptr; // Likewise
+        if (db->options.maxOpenTables <= 0) db->options.maxOpenTables = kDefaultMaxOpenTables;
         db->readOptions.fill_cache = true;
         db->readOptions.verify_checksums = false;
+        if (db->options.blockCacheBytes <= 0) db->options.blockCacheBytes = kDefaultBlockCacheBytes;
+        db->tableCache.reset(leveldb::NewLRUCache((size_t)db->options.maxOpenTables));
+        db->blockCache.reset(leveldb::NewLRUCache((size_t)db->options.blockCacheBytes));
+        if (db->options.secondaryCacheBytes > 0) db->secondaryCache = std::make_unique<SecondaryBlockCache>((size_t)db->options.secondaryCacheBytes);
+        if (db->options.locationHints > 0) db->hints = std::make_unique<LocationHints>((size_t)db->options.locationHints);
+        if (!db->snapshotPath.empty()) LoadMetadataSnapshot(db->snapshotPath, dir, db->manifest);
+        RefreshManifest(dir, db->manifest);
+
+        // Tables are only registered here; files are opened on first lookup.
+        auto set = std::make_shared<TableSet>();
         for (auto const& entry : std::filesystem::directory_iterator(dir, ec)) {
             if (ec || !entry.is_regular_file()) continue;
-            std::string file = entry.path().string();
             if (!entry.path().filename().string().ends_with(".ldb")) continue;
-            auto tbl = LoadTable(file);
-            if (tbl) db->tables.push_back(std::move(tbl));
+            auto tbl = RegisterTable(db, entry.path().string(), static_cast<uint64_t>(entry.file_size(ec)));
+            if (tbl) set->tables.push_back(std::move(tbl));
         }
-        if (db->tables.empty()) { delete db; return nullptr; }
+        if (set->tables.empty()) { delete db; return nullptr; }
 
-        std::stable_sort(db->tables.begin(), db->tables.end(),
-            [](auto const& a, auto const& b) { return a->path > b->path; });
-
-        for (size_t i = 0; i < db->tables.size(); ++i)
-            db->pathIndex.emplace(db->tables[i]->path, i);
+        SortTables(*set);
+        if (!chunkIndexPath.empty()) set->chunkIndex = OpenChunkIndex(chunkIndexPath, FingerprintTables(*set));
+        if (db->options.preopenTables) {
+            std::vector<const SSTable*> all;
+            all.reserve(set->tables.size());
+            for (auto& t : set->tables) all.push_back(t.get());
+            PreopenTables(db, all);
+        }
+        db->current.store(std::move(set));
+        return rec.Created(db);
+    }
 
-        return db;
+    EXPORT BedrockDB* OpenDB(const char* path) {
+        return OpenDBWithOptions(path, nullptr);
     }
 
+    // Safe to call while lookups and iterations run on other threads: the new table set is built
+    // off to the side and published atomically. Concurrent UpdateDB calls are serialized.
     EXPORT bool UpdateDB(BedrockDB* db, const char* path) {
+        CallRecord rec(kRecUpdateDB);
+        rec.Handle(db);
         if (!db || !path) return false;
         std::error_code ec; std::filesystem::path dir(path);
         if (!std::filesystem::exists(dir, ec) || !std::filesystem::is_directory(dir, ec)) return false;
+        std::lock_guard<std::mutex> lock(db->updateMutex);
+        ScopedTimer timer(kTimerUpdateDB);
+        TraceSpan span("UpdateDB");
         bool changed = false;
         std::vector<std::pair<std::string, uint64_t>> foundFiles;
         foundFiles.reserve(64);
-        for (auto const& entry : std::filesystem::directory_iterator(dir, ec)) {
-            if (ec || !entry.is_regular_file()) continue;
-            auto fname = entry.path().filename().string();
-            if (!fname.ends_with(".ldb")) continue;
-            foundFiles.emplace_back(entry.path().string(), static_cast<uint64_t>(entry.file_size(ec)));
+        {
+            TraceSpan scan("scan directory");
+            for (auto const& entry : std::filesystem::directory_iterator(dir, ec)) {
+                if (ec || !entry.is_regular_file()) continue;
+                auto fname = entry.path().filename().string();
+                if (!fname.ends_with(".ldb")) continue;
+                foundFiles.emplace_back(entry.path().string(), static_cast<uint64_t>(entry.file_size(ec)));
+            }
         }
+        RefreshManifest(dir, db->manifest);
 
-        for (auto const& [fullPath, size] : foundFiles) {
-            auto it = db->pathIndex.find(fullPath);
-            if (it == db->pathIndex.end()) {
-                auto tbl = LoadTable(fullPath);
-                if (tbl) { db->pathIndex.emplace(fullPath, db->tables.size()); db->tables.push_back(std::move(tbl)); changed = true; }
+        std::unordered_map<std::string, uint64_t> onDisk(foundFiles.begin(), foundFiles.end());
+        auto retire = [&](const SSTable& t) {
+            t.slot->retired = true;
+            db->retiredTables.fetch_add(1, std::memory_order_relaxed);
+            changed = true;
+        };
+
+        auto cur = db->current.load();
+        auto next = std::make_shared<TableSet>();
+        next->tables.reserve(cur->tables.size() + 8);
+
+        std::vector<const SSTable*> added;
+        for (const auto& tp : cur->tables) {
+            const SSTable& t = *tp;
+            auto disk = onDisk.find(t.path);
+            // Compaction deletes inputs once the MANIFEST drops them; until the game actually
+            // removes the file it is still on disk but no longer live.
+            bool obsolete = db->manifest.valid && !db->manifest.files.contains(t.number);
+            if (disk == onDisk.end() || obsolete) { retire(t); continue; }
+
+            if (t.fileSize != disk->second) {
+                auto fresh = RegisterTable(db, t.path, disk->second);
+                retire(t);
+                if (fresh) { added.push_back(fresh.get()); next->tables.push_back(std::move(fresh)); }
+                continue;
             }
-            else {
-                size_t idx = it->second;
-                if (idx < db->tables.size() && db->tables[idx]->fileSize != size) {
-                    auto fresh = LoadTable(fullPath);
-                    if (fresh) {
-                        delete db->tables[idx]->table; delete db->tables[idx]->file;
-                        db->tables[idx] = std::move(fresh); changed = true;
-                    }
+            if (db->manifest.valid) {
+                // A trivial move keeps the file number but moves the table one level down.
+                // Same file, so the copy shares its cache slot and any open handle.
+                int level = db->manifest.files.find(t.number)->second.level;
+                if (level != t.level) {
+                    auto moved = std::make_shared<SSTable>(t);
+                    moved->level = level;
+                    next->tables.push_back(std::move(moved)); changed = true;
+                    continue;
                 }
             }
+            next->tables.push_back(tp);
+        }
+
+        for (auto const& [fullPath, size] : foundFiles) {
+            if (cur->pathIndex.contains(fullPath)) continue;
+            auto tbl = RegisterTable(db, fullPath, size);
+            if (tbl) { added.push_back(tbl.get()); next->tables.push_back(std::move(tbl)); changed = true; }
         }
+        if (db->options.preopenTables && !added.empty()) PreopenTables(db, added);
         if (changed) {
-            std::stable_sort(db->tables.begin(), db->tables.end(),
-                [](auto const& a, auto const& b) { return a->path > b->path; });
-            db->pathIndex.clear();
-            for (size_t i = 0; i < db->tables.size(); ++i) db->pathIndex.emplace(db->tables[i]->path, i);
+            SortTables(*next);
+            next->generation = cur->generation + 1;
+            db->current.store(std::move(next));
         }
-        return changed;
+        return rec.Return(changed);
+    }
+
+    EXPORT void GetTableSetStats(BedrockDB* db, TableSetStats* out) {
+        if (!db || !out) return;
+        auto set = db->current.load();
+        out->generation = set->generation;
+        out->activeTables = (uint32_t)set->tables.size();
+        out->openTables = (uint32_t)db->tableCache->TotalCharge();
+        out->retiredTables = db->retiredTables.load(std::memory_order_relaxed);
+        out->closedRetiredTables = db->closedRetiredTables.load(std::memory_order_relaxed);
+        out->chunkIndexKeys = set->chunkIndex ? set->chunkIndex->header.keyCount : 0;
+    }
+
+    EXPORT void GetBlockCacheStats(BedrockDB* db, BlockCacheStats* out) {
+        if (!db || !out) return;
+        *out = {};
+        out->primaryBytes = db->blockCache->TotalCharge();
+        if (db->secondaryCache) db->secondaryCache->GetStats(*out);
+        if (db->hints) db->hints->GetStats(*out);
     }
 
     EXPORT void CloseDB(BedrockDB* db) {
+        CallRecord rec(kRecCloseDB);
+        rec.Handle(db);
         if (!db) return;
-        for (auto& t : db->tables) { if (t) { delete t->table; delete t->file; } }
+        rec.Released(db);
+        WaitForPrefetch(db);
+        if (!db->snapshotPath.empty()) SaveMetadataSnapshot(db->snapshotPath, db->dir, db->manifest);
         delete db;
     }
 
-    EXPORT void IterateDB(
+    // Offline: writes the chunk index of every live chunk key with the given tag in the world at
+    // dbPath, for DBOptions.chunkIndexPath. Any later change to the world's tables retires it.
+    // Returns the number of keys indexed, or -1. Not recorded, nor are the open and close it makes.
+    EXPORT int64_t BuildChunkIndex(const char* dbPath, uint8_t tag, const char* outPath) {
+        if (!dbPath || !outPath) return -1;
+        InternalCalls internal;
+        BedrockDB* db = OpenDB(dbPath);
+        if (!db) return -1;
+        int64_t keys = WriteChunkIndex(db, tag, outPath);
+        CloseDB(db);
+        return keys;
+    }
+
+    // The long-running exports below take cancelFlag, a host-owned int that stops the call once it
+    // becomes non-zero, and deadlineMicros, a budget from the start of the call (<= 0 for none).
+    // Either may be left unset. They return a CallStatus; on a stop the results are partial.
+
+    EXPORT int32_t IterateDB(
         BedrockDB* db,
         const uint8_t* prefix, int32_t prefixLen,
         const uint8_t* suffix, int32_t suffixLen,
-        DBIterateCallback callback
+        DBIterateCallback callback,
+        int32_t* cancelFlag,
+        int64_t deadlineMicros
     ) {
-        if (!db || !callback) return;
-
-        // 1. Create iterators for all tables
-        std::vector<std::unique_ptr<leveldb::Iterator>> ownerVec;
-        std::vector<IterWrapper> wrappers;
-        ownerVec.reserve(db->tables.size());
-        wrappers.reserve(db->tables.size());
-
-        // Create separate iterators to avoid messing with the thread-local cache
-        for (size_t i = 0; i < db->tables.size(); ++i) {
-            auto* it = db->tables[i]->table->NewIterator(db->readOptions);
-            ownerVec.emplace_back(it);
-
-            if (prefix && prefixLen > 0) {
-                leveldb::Slice p((const char*)prefix, prefixLen);
-                it->Seek(p);
-            }
-            else {
-                it->SeekToFirst();
-            }
-
-            if (it->Valid()) {
-                wrappers.emplace_back(it, i);
-            }
-        }
+        CallRecord rec(kRecIterateDB);
+        rec.Handle(db);
+        rec.Bytes(prefix, prefix ? (size_t)std::max(prefixLen, 0) : 0);
+        rec.Bytes(suffix, suffix ? (size_t)std::max(suffixLen, 0) : 0);
+        if (!db || !callback) return kStatusInvalid;
+        StopToken stop(cancelFlag, deadlineMicros);
 
-        // 2. Priority Queue for Merging
-        std::priority_queue<IterWrapper*, std::vector<IterWrapper*>, IterCompare> pq;
-        for (auto& w : wrappers) {
-            if (w.iter->Valid()) pq.push(&w);
-        }
-
-        std::string lastUserKey;
-        bool first = true;
-
-        std::string_view prefixView;
+        std::string_view prefixView, suffixView;
         if (prefix && prefixLen > 0) prefixView = std::string_view((const char*)prefix, prefixLen);
-
-        std::string_view suffixView;
         if (suffix && suffixLen > 0) suffixView = std::string_view((const char*)suffix, suffixLen);
-
-        while (!pq.empty()) {
-            IterWrapper* top = pq.top();
-            pq.pop();
-
-            // 3. Process Key
-            std::string_view currentKey = top->userKey;
-
-            // Check Prefix (optimization: if sorted key doesn't start with prefix, we are done)
-            if (!prefixView.empty()) {
-                if (currentKey.size() < prefixView.size() ||
-                    currentKey.substr(0, prefixView.size()) != prefixView) {
-                    // Since keys are sorted, any subsequent key will also not match
-                    break;
-                }
-            }
-
-            // Check Duplicates (Shadowing)
-            // Since tables are sorted by age (index 0 = newest), the first time we see a key, it is the newest version.
-            bool isNewKey = first || currentKey != lastUserKey;
-
-            if (isNewKey) {
-                first = false;
-                lastUserKey = std::string(currentKey);
-
-                // Check Type (last byte of internal key usually)
-                // We need to look at the internal key to see if it's a deletion.
-                // Internal Key: [User Key][Trailer(8b)]
-                // Trailer is (Seq << 8) | Type
-                // In Little Endian (EncodeFixed64), the first byte of the trailer is the Type.
-                leveldb::Slice raw = top->iter->key();
-                uint8_t type = 0;
-
-                if (raw.size() >= 8) {
-                    // Get the byte at offset (size - 8)
-                    type = (uint8_t)raw.data()[raw.size() - 8];
-                }
-
-                // kTypeDeletion = 0x0, kTypeValue = 0x1
-                // If type is 0 (Deletion), we skip callback (it's deleted).
-
-                if (type == 0x1) {
-                    // Check Suffix
-                    bool suffixMatch = true;
-                    if (!suffixView.empty()) {
-                        if (currentKey.size() < suffixView.size() ||
-                            currentKey.substr(currentKey.size() - suffixView.size()) != suffixView) {
-                            suffixMatch = false;
-                        }
-                    }
-
-                    if (suffixMatch) {
-                        leveldb::Slice v = top->iter->value();
-                        callback(
-                            (const uint8_t*)currentKey.data(), (int32_t)currentKey.size(),
-                            (const uint8_t*)v.data(), (int32_t)v.size()
-                        );
-                    }
-                }
-            }
-
-            // 4. Advance Iterator
-            top->iter->Next();
-            top->Update();
-            if (top->iter->Valid()) {
-                pq.push(top);
-            }
-        }
+        auto set = db->current.load();
+        IterateTables(db, *set, prefixView, suffixView, callback, stop);
+        return rec.Return(stop.status.load());
     }
 
-    struct TempResult {
-        std::vector<uint8_t> data;
-        bool found;
-    };
-
-    EXPORT void BatchGetFlat(
+    EXPORT int32_t BatchGetFlat(
         BedrockDB* db,
         const uint8_t* flatKeys,
         const int32_t* keyOffsets,
@@ -473,68 +3911,156 @@ extern "C" {
         uint8_t** outDataBlock,
         int32_t* outDataOffsets,
         int32_t* outDataLengths,
-        uint8_t* outFound
+        uint8_t* outFound,
+        int32_t* cancelFlag,
+        int64_t deadlineMicros
     ) {
-        if (!db || count == 0) return;
+        CallRecord rec(kRecBatchGetFlat);
+        rec.Handle(db);
+        rec.Keys(flatKeys, keyOffsets, keyLengths, count);
+        if (!db || count == 0) return kStatusInvalid;
+        StopToken stop(cancelFlag, deadlineMicros);
         std::vector<TempResult> results(count);
+        auto set = db->current.load();
 
-        ParallelFor(0, count, [&](int i) {
-            results[i].found = InternalGetToBuffer(db, flatKeys + keyOffsets[i], (size_t)keyLengths[i], results[i].data);
+        ReadAheadBatchBlocks(db, *set, flatKeys, keyOffsets, keyLengths, count);
+
+        WithKeyOps(ClassifyKeys(keyLengths, count), [&](auto ops) {
+            using KeyOps = decltype(ops);
+            ParallelForRanges(0, count, [&](int tStart, int tEnd) {
+                InternalGetRangeToBuffers<KeyOps>(db, *set, flatKeys, keyOffsets, keyLengths, tStart, tEnd, results.data(), stop);
+                });
             });
 
-        size_t totalSize = 0;
-        for (int i = 0; i < count; ++i) {
-            if (results[i].found) totalSize += results[i].data.size();
-        }
+        *outDataBlock = PackResults(results.data(), count, outDataOffsets, outDataLengths, outFound);
+        return rec.Return(stop.status.load());
+    }
 
-        uint8_t* dataBlock = (uint8_t*)malloc(totalSize > 0 ? totalSize : 1);
-        size_t currentOffset = 0;
+    // Like BatchGetFlat, but runs the keys wave by wave in the order given and calls callback once
+    // per wave as soon as it has finished, so a caller that orders keys nearest first gets the near
+    // results before the far ones. waveEnds holds the exclusive end index of each wave; the last one
+    // must be count. The data block passed to callback is only valid during the call. A stopped
+    // call still delivers the wave it was in, then returns.
+    EXPORT int32_t BatchGetStreaming(
+        BedrockDB* db,
+        const uint8_t* flatKeys,
+        const int32_t* keyOffsets,
+        const int32_t* keyLengths,
+        int32_t count,
+        const int32_t* waveEnds,
+        int32_t waveCount,
+        BatchWaveCallback callback,
+        int32_t* cancelFlag,
+        int64_t deadlineMicros
+    ) {
+        CallRecord rec(kRecBatchGetStreaming);
+        rec.Handle(db);
+        rec.Keys(flatKeys, keyOffsets, keyLengths, count);
+        rec.Int(waveEnds ? std::max(waveCount, 0) : 0);
+        for (int32_t w = 0; waveEnds && w < waveCount; ++w) rec.Int(waveEnds[w]);
+        if (!db || count <= 0 || !waveEnds || waveCount <= 0 || !callback) return kStatusInvalid;
+        StopToken stop(cancelFlag, deadlineMicros);
+        std::vector<TempResult> results(count);
+        std::vector<int32_t> outOffsets(count), outLengths(count);
+        std::vector<uint8_t> outFound(count);
+        auto set = db->current.load();
 
-        for (int i = 0; i < count; ++i) {
-            outFound[i] = results[i].found ? 1 : 0;
-            if (results[i].found) {
-                size_t len = results[i].data.size();
-                memcpy(dataBlock + currentOffset, results[i].data.data(), len);
-                outDataOffsets[i] = (int32_t)currentOffset;
-                outDataLengths[i] = (int32_t)len;
-                currentOffset += len;
-            }
-            else {
-                outDataOffsets[i] = 0;
-                outDataLengths[i] = 0;
+        WithKeyOps(ClassifyKeys(keyLengths, count), [&](auto ops) {
+            using KeyOps = decltype(ops);
+            int32_t waveStart = 0;
+            for (int32_t w = 0; w < waveCount && waveStart < count && !stop.Stopped(); ++w) {
+                int32_t waveEnd = std::clamp(waveEnds[w], waveStart, count);
+                if (waveEnd == waveStart) continue;
+                int32_t n = waveEnd - waveStart;
+                ReadAheadBatchBlocks(db, *set, flatKeys, keyOffsets + waveStart, keyLengths + waveStart, n);
+                ParallelForRanges(waveStart, waveEnd, [&](int tStart, int tEnd) {
+                    InternalGetRangeToBuffers<KeyOps>(db, *set, flatKeys, keyOffsets, keyLengths, tStart, tEnd, results.data(), stop);
+                    });
+                uint8_t* block = PackResults(results.data() + waveStart, n, outOffsets.data() + waveStart, outLengths.data() + waveStart, outFound.data() + waveStart);
+                callback(waveStart, n, block, outOffsets.data() + waveStart, outLengths.data() + waveStart, outFound.data() + waveStart);
+                free(block);
+                for (int32_t i = waveStart; i < waveEnd; ++i) std::vector<uint8_t>().swap(results[i].data);
+                waveStart = waveEnd;
             }
+            });
+        return rec.Return(stop.status.load());
+    }
+
+    // Warms the table blocks for keys on a background task and returns immediately. Returns false
+    // when the previous prefetch is still running. Call from the thread that drives UpdateDB.
+    EXPORT bool Prefetch(
+        BedrockDB* db,
+        const uint8_t* flatKeys,
+        const int32_t* keyOffsets,
+        const int32_t* keyLengths,
+        int32_t count
+    ) {
+        CallRecord rec(kRecPrefetch);
+        rec.Handle(db);
+        rec.Keys(flatKeys, keyOffsets, keyLengths, count);
+        if (!db || !flatKeys || count <= 0) return false;
+        std::vector<uint8_t> keys;
+        std::vector<int32_t> offsets(count), lengths(count);
+        for (int32_t i = 0; i < count; ++i) {
+            offsets[i] = (int32_t)keys.size();
+            lengths[i] = keyLengths[i];
+            keys.insert(keys.end(), flatKeys + keyOffsets[i], flatKeys + keyOffsets[i] + keyLengths[i]);
         }
-        *outDataBlock = dataBlock;
+        return rec.Return(StartPrefetch(db, std::move(keys), std::move(offsets), std::move(lengths)));
     }
 
-    EXPORT LogSession* OpenLogSession(const char* dbPath) {
+    // Same as Prefetch for the chunk keys with the given tag in [minX, maxX] x [minZ, maxZ].
+    EXPORT bool PrefetchChunkRect(BedrockDB* db, int32_t minX, int32_t minZ, int32_t maxX, int32_t maxZ, int32_t dim, uint8_t tag) {
+        CallRecord rec(kRecPrefetchChunkRect);
+        rec.Handle(db);
+        for (int32_t v : { minX, minZ, maxX, maxZ, dim, (int32_t)tag }) rec.Int(v);
+        return rec.Return(StartChunkRectPrefetch(db, minX, minZ, maxX, maxZ, dim, tag));
+    }
+
+    // Only verifyChecksums is taken from options.
+    EXPORT LogSession* OpenLogSessionWithOptions(const char* dbPath, const DBOptions* options) {
+        CallRecord rec(kRecOpenLogSession);
+        rec.Str(dbPath);
+        rec.Int(options ? options->verifyChecksums : 0);
         if (!dbPath) return nullptr;
         std::error_code ec; std::filesystem::path dir(dbPath);
         if (!std::filesystem::exists(dir, ec) || !std::filesystem::is_directory(dir, ec)) return nullptr;
         auto session = new LogSession();
+        session->verifyChecksums = options && options->verifyChecksums;
         session->logs.reserve(16);
         for (auto const& entry : std::filesystem::directory_iterator(dir, ec)) {
             if (ec || !entry.is_regular_file()) continue;
             if (!entry.path().filename().string().ends_with(".log")) continue;
             auto log = std::make_unique<MappedLog>();
             log->path = entry.path().string();
-            log->hFile = CreateFileA(log->path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-            if (log->hFile == INVALID_HANDLE_VALUE) continue;
+            log->file = OpenReadOnlyFile(log->path, FileAccess::Sequential);
+            if (log->file == kNoFile) continue;
             if (RemapLogIfNeeded(log.get())) session->logs.push_back(std::move(log));
             else CloseSingleLog(log.get());
         }
         if (session->logs.empty()) { delete session; return nullptr; }
-        return session;
+        return rec.Created(session);
+    }
+
+    EXPORT LogSession* OpenLogSession(const char* dbPath) {
+        return OpenLogSessionWithOptions(dbPath, nullptr);
     }
 
     EXPORT void CloseLogSession(LogSession* session) {
+        CallRecord rec(kRecCloseLogSession);
+        rec.Handle(session);
         if (!session) return;
+        rec.Released(session);
         for (auto& log : session->logs) CloseSingleLog(log.get());
         delete session;
     }
 
     EXPORT bool UpdateLogSession(LogSession* session, const char* logDir) {
+        CallRecord rec(kRecUpdateLogSession);
+        rec.Handle(session);
         if (!session || !logDir) return false;
+        ScopedTimer timer(kTimerUpdateLogSession);
+        TraceSpan span("UpdateLogSession");
         std::error_code ec; std::filesystem::path dir(logDir);
         if (!std::filesystem::exists(dir, ec) || !std::filesystem::is_directory(dir, ec)) return false;
 
@@ -557,15 +4083,15 @@ extern "C" {
             for (auto& log : session->logs) if (log->path == path) { already = true; break; }
             if (already) continue;
             auto log = std::make_unique<MappedLog>(); log->path = path;
-            log->hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-            if (log->hFile == INVALID_HANDLE_VALUE) continue;
+            log->file = OpenReadOnlyFile(path, FileAccess::Sequential);
+            if (log->file == kNoFile) continue;
             if (RemapLogIfNeeded(log.get())) { session->logs.push_back(std::move(log)); changed = true; }
             else CloseSingleLog(log.get());
         }
-        return changed;
+        return rec.Return(changed);
     }
 
-    EXPORT void BatchGetSessionFlat(
+    EXPORT int32_t BatchGetSessionFlat(
         LogSession* session,
         const uint8_t* flatKeys,
         const int32_t* keyOffsets,
@@ -574,36 +4100,321 @@ extern "C" {
         uint8_t** outDataBlock,
         int32_t* outDataOffsets,
         int32_t* outDataLengths,
-        uint8_t* outFound
+        uint8_t* outFound,
+        int32_t* cancelFlag,
+        int64_t deadlineMicros
     ) {
-        if (!session || count == 0) return;
+        CallRecord rec(kRecBatchGetSessionFlat);
+        rec.Handle(session);
+        rec.Keys(flatKeys, keyOffsets, keyLengths, count);
+        if (!session || count == 0) return kStatusInvalid;
+        StopToken stop(cancelFlag, deadlineMicros);
         std::vector<TempResult> results(count);
 
-        ParallelFor(0, count, [&](int i) {
-            results[i].found = InternalGetFromSessionToBuffer(session, flatKeys + keyOffsets[i], (size_t)keyLengths[i], results[i].data);
+        WithKeyOps(ClassifyKeys(keyLengths, count), [&](auto ops) {
+            using KeyOps = decltype(ops);
+            ParallelFor(0, count, [&](int i) {
+                if (stop.Stopped()) return;
+                results[i].found = InternalGetFromSessionToBuffer<KeyOps>(session, flatKeys + keyOffsets[i], (size_t)keyLengths[i], results[i].data);
+                });
             });
 
-        size_t totalSize = 0;
-        for (int i = 0; i < count; ++i) if (results[i].found) totalSize += results[i].data.size();
+        *outDataBlock = PackResults(results.data(), count, outDataOffsets, outDataLengths, outFound);
+        return rec.Return(stop.status.load());
+    }
+
+    // Creates a ring whose frames hold up to capacity boxes each.
+    EXPORT ResultRing* CreateResultRing(int32_t capacity) {
+        CallRecord rec(kRecCreateResultRing);
+        rec.Int(capacity);
+        if (capacity <= 0) return nullptr;
+        auto ring = new ResultRing();
+        ring->storage = AllocatePageBuffer(sizeof(RenderBox) * size_t(capacity) * 3);
+        if (!ring->storage.data) { delete ring; return nullptr; }
+        for (int i = 0; i < 3; ++i) {
+            ring->frames[i].boxes = static_cast<RenderBox*>(ring->storage.data) + size_t(capacity) * i;
+            ring->frames[i].capacity = capacity;
+        }
+        return rec.Created(ring);
+    }
 
-        uint8_t* dataBlock = (uint8_t*)malloc(totalSize > 0 ? totalSize : 1);
-        size_t currentOffset = 0;
+    EXPORT void DestroyResultRing(ResultRing* ring) {
+        CallRecord rec(kRecDestroyResultRing);
+        rec.Handle(ring);
+        if (ring) rec.Released(ring);
+        delete ring;
+    }
 
-        for (int i = 0; i < count; ++i) {
-            outFound[i] = results[i].found ? 1 : 0;
-            if (results[i].found) {
-                size_t len = results[i].data.size();
-                memcpy(dataBlock + currentOffset, results[i].data.data(), len);
-                outDataOffsets[i] = (int32_t)currentOffset;
-                outDataLengths[i] = (int32_t)len;
-                currentOffset += len;
-            }
-            else {
-                outDataOffsets[i] = 0; outDataLengths[i] = 0;
+    // Returns the newest published frame. The frame stays valid and unchanged until the next call,
+    // which must come from the same thread.
+    EXPORT const ResultFrame* AcquireLatestFrame(ResultRing* ring) {
+        return ring ? AcquireFrame(ring) : nullptr;
+    }
+
+    // Queries the boxes around chunk (cx, cz) and publishes them into ring. session may be null.
+    EXPORT int32_t QueryChunkBoxes(BedrockDB* db, LogSession* session, int32_t cx, int32_t cz, int32_t radius, int32_t dim, ResultRing* ring,
+        int32_t* cancelFlag, int64_t deadlineMicros) {
+        CallRecord rec(kRecQueryChunkBoxes);
+        rec.Handle(db);
+        rec.Handle(session);
+        rec.Handle(ring);
+        for (int32_t v : { cx, cz, radius, dim }) rec.Int(v);
+        if (!db || !ring || radius < 0 || radius > kMaxQueryRadius) return kStatusInvalid;
+        StopToken stop(cancelFlag, deadlineMicros);
+        RunBoxQuery(db, session, cx, cz, radius, dim, ring, stop);
+        return rec.Return(stop.status.load());
+    }
+
+    // Library-wide counters and latencies since the last ResetStats, summed over all threads.
+    EXPORT void GetStats(DBStats* out) {
+        if (!out) return;
+        auto& r = Registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        DBStats total = r.retired;
+        for (auto* t : r.live) AddThreadStats(*t, total);
+        for (int i = 0; i < kStatCounterCount; ++i) total.counters[i] -= r.baseline.counters[i];
+        for (int i = 0; i < kTimerCount; ++i) {
+            auto& h = total.timers[i];
+            const auto& b = r.baseline.timers[i];
+            h.count -= b.count;
+            h.totalNanos -= b.totalNanos;
+            for (int k = 0; k < kHistogramBuckets; ++k) h.buckets[k] -= b.buckets[k];
+        }
+        *out = total;
+    }
+
+    // Counters keep running; GetStats reports relative to this point. Maxima restart from zero.
+    EXPORT void ResetStats() {
+        auto& r = Registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& h : r.retired.timers) h.maxNanos = 0;
+        for (auto* t : r.live) {
+            for (auto& h : t->timers) h.maxNanos.store(0, std::memory_order_relaxed);
+        }
+        DBStats total = r.retired;
+        for (auto* t : r.live) AddThreadStats(*t, total);
+        r.baseline = total;
+    }
+
+    // Sets how file mappings and large buffers opened from now on use huge pages, and returns the
+    // mode this machine can actually provide, which may be lower than requested.
+    EXPORT int32_t SetHugePages(int32_t mode) {
+        int32_t available = AvailableHugePages(mode);
+        g_hugePages.store(available, std::memory_order_relaxed);
+        return available;
+    }
+
+    EXPORT void SetTraceEnabled(bool enabled) {
+        Tracer().enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    // Drops everything recorded so far from future dumps.
+    EXPORT void ClearTrace() {
+        Tracer().floorNanos.store(TraceNow(), std::memory_order_relaxed);
+    }
+
+    // Writes the newest spans of every thread to path as Chrome trace-event JSON. Spans recorded
+    // while the dump runs may be missing or, if a thread laps its ring meanwhile, garbled; pause
+    // tracing first for an exact dump.
+    EXPORT bool DumpTrace(const char* path) {
+        if (!path) return false;
+        auto& r = Tracer();
+        uint64_t floor = r.floorNanos.load(std::memory_order_relaxed);
+        std::vector<TraceEvent> events;
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (auto& ring : r.rings) {
+                uint64_t head = ring->head.load(std::memory_order_acquire);
+                uint64_t n = std::min<uint64_t>(head, kTraceRingEvents);
+                for (uint64_t i = head - n; i < head; ++i) {
+                    const TraceEvent& e = ring->events[i % kTraceRingEvents];
+                    if (e.startNanos >= floor) events.push_back(e);
+                }
             }
         }
-        *outDataBlock = dataBlock;
+        std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.startNanos < b.startNanos; });
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        char line[256];
+        for (size_t i = 0; i < events.size(); ++i) {
+            const TraceEvent& e = events[i];
+            int len = snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                i ? "," : "", e.name, e.tid, e.startNanos / 1000.0, e.durNanos / 1000.0);
+            out.write(line, len);
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+
+    // Starts logging every exported call to path, replacing the file. Fails if already recording.
+    EXPORT bool StartRecording(const char* path) {
+        if (!path) return false;
+        auto& r = Recorder();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (r.file) return false;
+        r.file = fopen(path, "wb");
+        if (!r.file) return false;
+        r.buffer.assign(kRecordMagic, sizeof(kRecordMagic));
+        uint32_t header[2] = { kRecordVersion, 0 };
+        r.buffer.append(reinterpret_cast<const char*>(header), sizeof(header));
+        r.ids.clear();
+        r.nextId = 1;
+        r.session++;
+        r.epoch = std::chrono::steady_clock::now();
+        r.active.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Calls still running are left out of the recording.
+    EXPORT void StopRecording() {
+        auto& r = Recorder();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.active.store(false, std::memory_order_relaxed);
+        if (!r.file) return;
+        FlushRecording(r);
+        fclose(r.file);
+        r.file = nullptr;
     }
 
     EXPORT void FreeBuffer(uint8_t* buffer) { free(buffer); }
-}
\ No newline at end of file
+}
+
+// Background tracker
+
+// Owns a db, its log session and a result ring, and keeps the ring answering the latest posted
+// position on its own thread. Positions posted faster than queries complete are coalesced: the
+// worker always takes the newest one and drops those in between.
+struct Tracker {
+    std::string dir;
+    BedrockDB* db = nullptr;
+    LogSession* session = nullptr; // Worker only; null until the world has a .log file
+    ResultRing* ring = nullptr;
+    int32_t radius = 0;
+
+    int32_t cancel = 0; // Set by StopTracker to abandon the query in flight
+    std::mutex mutex; // Guards pending, hasPending and stop
+    std::condition_variable wake;
+    ChunkPosition pending{};
+    bool hasPending = false;
+    bool stop = false;
+    std::thread worker;
+};
+
+constexpr int32_t kTrackerLookahead = 2; // Chunks warmed ahead along the movement
+
+static void RunTracker(Tracker* t) {
+    std::optional<ChunkPosition> last;
+    for (;;) {
+        ChunkPosition pos;
+        {
+            std::unique_lock<std::mutex> lock(t->mutex);
+            t->wake.wait(lock, [t] { return t->stop || t->hasPending; });
+            if (t->stop) return;
+            pos = t->pending;
+            t->hasPending = false;
+        }
+        CallRecord rec(kRecTrackerQuery);
+        rec.Handle(t);
+        for (int32_t v : { pos.x, pos.z, pos.dim }) rec.Int(v);
+
+        // The table scan and the log remap touch disjoint state, so run them side by side.
+        auto tables = std::async(std::launch::async, [t] { InternalCalls internal; UpdateDB(t->db, t->dir.c_str()); });
+        if (t->session) UpdateLogSession(t->session, t->dir.c_str());
+        else t->session = OpenLogSessionWithOptions(t->dir.c_str(), &t->db->options);
+        tables.wait();
+
+        StopToken stop(&t->cancel, 0);
+        RunBoxQuery(t->db, t->session, pos.x, pos.z, t->radius, pos.dim, t->ring, stop);
+        rec.Return(stop.status.load());
+        if (stop.Stopped()) return;
+
+        // Warm the window a couple of chunks further along the movement so the next query after
+        // crossing a chunk border doesn't start cold.
+        if (last && last->dim == pos.dim) {
+            int32_t mx = ((pos.x > last->x) - (pos.x < last->x)) * kTrackerLookahead;
+            int32_t mz = ((pos.z > last->z) - (pos.z < last->z)) * kTrackerLookahead;
+            if (mx != 0 || mz != 0) {
+                StartChunkRectPrefetch(t->db, pos.x - t->radius + mx, pos.z - t->radius + mz,
+                    pos.x + t->radius + mx, pos.z + t->radius + mz, pos.dim, kAABBVolumesTag);
+            }
+        }
+        last = pos;
+    }
+}
+
+extern "C" {
+    // Opens the world at dbPath and starts a worker that answers SetPosition with frames of the boxes
+    // within radius chunks. options may be null.
+    EXPORT Tracker* StartTracker(const char* dbPath, const DBOptions* options, int32_t radius, int32_t capacity) {
+        CallRecord rec(kRecStartTracker);
+        rec.Str(dbPath);
+        rec.Int(options ? options->maxOpenTables : 0);
+        rec.Int(options ? options->preopenTables : 0);
+        rec.Int(radius);
+        rec.Int(capacity);
+        rec.Int(options ? options->verifyChecksums : 0);
+        rec.Int(options ? options->blockCacheBytes : 0);
+        rec.Int(options ? options->secondaryCacheBytes : 0);
+        rec.Int(options ? options->locationHints : 0);
+        rec.Str(options ? options->snapshotPath : nullptr);
+        rec.Str(options ? options->chunkIndexPath : nullptr);
+        rec.Int(options ? options->disableReadAhead : 0);
+        if (!dbPath || radius < 0 || radius > kMaxQueryRadius || capacity <= 0) return nullptr;
+        BedrockDB* db = OpenDBWithOptions(dbPath, options);
+        if (!db) return nullptr;
+        auto t = new Tracker();
+        t->dir = dbPath;
+        t->db = db;
+        t->session = OpenLogSessionWithOptions(dbPath, options);
+        t->ring = CreateResultRing(capacity);
+        if (!t->ring) {
+            CloseLogSession(t->session);
+            CloseDB(db);
+            delete t;
+            return rec.Created<Tracker>(nullptr);
+        }
+        t->radius = radius;
+        t->worker = std::thread(RunTracker, t);
+        return rec.Created(t);
+    }
+
+    // Posts the player's chunk position. Never waits for a query in progress.
+    EXPORT void SetPosition(Tracker* t, int32_t x, int32_t z, int32_t dim) {
+        CallRecord rec(kRecSetPosition);
+        rec.Handle(t);
+        for (int32_t v : { x, z, dim }) rec.Int(v);
+        if (!t) return;
+        rec.Return(kStatusOk);
+        {
+            std::lock_guard<std::mutex> lock(t->mutex);
+            t->pending = { x, z, dim };
+            t->hasPending = true;
+        }
+        t->wake.notify_one();
+    }
+
+    // Same contract as AcquireLatestFrame.
+    EXPORT const ResultFrame* GetLatest(Tracker* t) {
+        return t && t->ring ? AcquireFrame(t->ring) : nullptr;
+    }
+
+    EXPORT void StopTracker(Tracker* t) {
+        CallRecord rec(kRecStopTracker);
+        rec.Handle(t);
+        if (!t) return;
+        rec.Released(t);
+        {
+            std::lock_guard<std::mutex> lock(t->mutex);
+            t->stop = true;
+        }
+        std::atomic_ref<int32_t>(t->cancel).store(1, std::memory_order_relaxed);
+        t->wake.notify_one();
+        t->worker.join();
+        CloseLogSession(t->session);
+        CloseDB(t->db);
+        DestroyResultRing(t->ring);
+        delete t;
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+// The exported C surface of LevelDBMinimal, for the tools that link against the library.
+// Handles are opaque; the structs mirror their definitions in LevelDBMinimal.cpp.
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#define LEVELDBMINIMAL_IMPORT __declspec(dllimport)
+#else
+#define LEVELDBMINIMAL_IMPORT
+#endif
+
+struct BedrockDB;
+struct LogSession;
+struct ResultRing;
+struct Tracker;
+struct ResultFrame;
+
+struct DBOptions {
+    int32_t maxOpenTables = 512;
+    int32_t preopenTables = 0;
+    const char* snapshotPath = nullptr;
+    int32_t verifyChecksums = 0;
+    int64_t blockCacheBytes = 0;
+    int64_t secondaryCacheBytes = 0;
+    int32_t locationHints = 0;
+    const char* chunkIndexPath = nullptr;
+    int32_t disableReadAhead = 0;
+};
+
+struct TableSetStats {
+    uint64_t generation;
+    uint32_t activeTables;
+    uint32_t openTables;
+    uint64_t retiredTables;
+    uint64_t closedRetiredTables;
+    uint64_t chunkIndexKeys;
+};
+
+struct BlockCacheStats {
+    uint64_t primaryBytes;
+    uint64_t secondaryBytes;
+    uint64_t secondaryHits;
+    uint64_t secondaryMisses;
+    uint64_t demotedBlocks;
+    uint64_t demotedBytes;
+    uint64_t packedBytes;
+    uint64_t hintHits;
+    uint64_t hintMisses;
+};
+
+enum StatCounter : int32_t {
+    kStatKeysLookedUp, kStatTablesProbed, kStatTablesSkipped, kStatTableCacheHits, kStatTableCacheMisses,
+    kStatBlocksRead, kStatBlockBytesRead, kStatBytesCopied, kStatSessionKeys, kStatKeysIterated,
+    kStatCounterCount
+};
+enum StatTimer : int32_t {
+    kTimerOpenDB, kTimerUpdateDB, kTimerUpdateLogSession, kTimerBatchLookup, kTimerSessionLookup, kTimerIterate, kTimerParallelFor,
+    kTimerCount
+};
+constexpr int kHistogramBuckets = 96;
+
+struct LatencyHistogram {
+    uint64_t count;
+    uint64_t totalNanos;
+    uint64_t maxNanos;
+    uint64_t buckets[kHistogramBuckets];
+};
+
+struct DBStats {
+    uint64_t counters[kStatCounterCount];
+    LatencyHistogram timers[kTimerCount];
+};
+
+enum CallStatus : int32_t { kStatusInvalid = -1, kStatusOk = 0, kStatusCancelled = 1, kStatusDeadline = 2 };
+enum HugePageMode : int32_t { kHugePagesOff = 0, kHugePagesTransparent = 1, kHugePagesExplicit = 2 };
+
+typedef void (*DBIterateCallback)(const uint8_t* key, int32_t keyLen, const uint8_t* val, int32_t valLen);
+typedef void (*BatchWaveCallback)(int32_t start, int32_t count, const uint8_t* dataBlock, const int32_t* dataOffsets, const int32_t* dataLengths, const uint8_t* found);
+
+extern "C" {
+    LEVELDBMINIMAL_IMPORT BedrockDB* OpenDBWithOptions(const char* path, const DBOptions* options);
+    LEVELDBMINIMAL_IMPORT BedrockDB* OpenDB(const char* path);
+    LEVELDBMINIMAL_IMPORT int64_t BuildChunkIndex(const char* dbPath, uint8_t tag, const char* outPath);
+    LEVELDBMINIMAL_IMPORT bool UpdateDB(BedrockDB* db, const char* path);
+    LEVELDBMINIMAL_IMPORT void GetTableSetStats(BedrockDB* db, TableSetStats* out);
+    LEVELDBMINIMAL_IMPORT void GetBlockCacheStats(BedrockDB* db, BlockCacheStats* out);
+    LEVELDBMINIMAL_IMPORT void CloseDB(BedrockDB* db);
+
+    LEVELDBMINIMAL_IMPORT int32_t IterateDB(BedrockDB* db, const uint8_t* prefix, int32_t prefixLen, const uint8_t* suffix, int32_t suffixLen,
+        DBIterateCallback callback, int32_t* cancelFlag, int64_t deadlineMicros);
+    LEVELDBMINIMAL_IMPORT int32_t BatchGetFlat(BedrockDB* db, const uint8_t* flatKeys, const int32_t* keyOffsets, const int32_t* keyLengths, int32_t count,
+        uint8_t** outDataBlock, int32_t* outDataOffsets, int32_t* outDataLengths, uint8_t* outFound, int32_t* cancelFlag, int64_t deadlineMicros);
+    LEVELDBMINIMAL_IMPORT int32_t BatchGetStreaming(BedrockDB* db, const uint8_t* flatKeys, const int32_t* keyOffsets, const int32_t* keyLengths, int32_t count,
+        const int32_t* waveEnds, int32_t waveCount, BatchWaveCallback callback, int32_t* cancelFlag, int64_t deadlineMicros);
+    LEVELDBMINIMAL_IMPORT bool Prefetch(BedrockDB* db, const uint8_t* flatKeys, const int32_t* keyOffsets, const int32_t* keyLengths, int32_t count);
+    LEVELDBMINIMAL_IMPORT bool PrefetchChunkRect(BedrockDB* db, int32_t minX, int32_t minZ, int32_t maxX, int32_t maxZ, int32_t dim, uint8_t tag);
+
+    LEVELDBMINIMAL_IMPORT LogSession* OpenLogSession(const char* dbPath);
+    LEVELDBMINIMAL_IMPORT LogSession* OpenLogSessionWithOptions(const char* dbPath, const DBOptions* options);
+    LEVELDBMINIMAL_IMPORT void CloseLogSession(LogSession* session);
+    LEVELDBMINIMAL_IMPORT bool UpdateLogSession(LogSession* session, const char* logDir);
+    LEVELDBMINIMAL_IMPORT int32_t BatchGetSessionFlat(LogSession* session, const uint8_t* flatKeys, const int32_t* keyOffsets, const int32_t* keyLengths, int32_t count,
+        uint8_t** outDataBlock, int32_t* outDataOffsets, int32_t* outDataLengths, uint8_t* outFound, int32_t* cancelFlag, int64_t deadlineMicros);
+
+    LEVELDBMINIMAL_IMPORT ResultRing* CreateResultRing(int32_t capacity);
+    LEVELDBMINIMAL_IMPORT void DestroyResultRing(ResultRing* ring);
+    LEVELDBMINIMAL_IMPORT int32_t QueryChunkBoxes(BedrockDB* db, LogSession* session, int32_t cx, int32_t cz, int32_t radius, int32_t dim, ResultRing* ring,
+        int32_t* cancelFlag, int64_t deadlineMicros);
+
+    LEVELDBMINIMAL_IMPORT Tracker* StartTracker(const char* dbPath, const DBOptions* options, int32_t radius, int32_t capacity);
+    LEVELDBMINIMAL_IMPORT void SetPosition(Tracker* t, int32_t x, int32_t z, int32_t dim);
+    LEVELDBMINIMAL_IMPORT const ResultFrame* GetLatest(Tracker* t);
+    LEVELDBMINIMAL_IMPORT void StopTracker(Tracker* t);
+
+    LEVELDBMINIMAL_IMPORT void GetStats(DBStats* out);
+    LEVELDBMINIMAL_IMPORT void ResetStats();
+
+    LEVELDBMINIMAL_IMPORT int32_t SetHugePages(int32_t mode);
+
+    LEVELDBMINIMAL_IMPORT bool StartRecording(const char* path);
+    LEVELDBMINIMAL_IMPORT void StopRecording();
+
+    LEVELDBMINIMAL_IMPORT void FreeBuffer(uint8_t* buffer);
+}
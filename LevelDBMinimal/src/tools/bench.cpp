@@ -0,0 +1,460 @@
+// leveldbminimal_bench: measures the exported lookup, scan and refresh paths against a world on disk
+// and prints one JSON document per run, so results can be diffed across releases.
+//
+// leveldbminimal_bench --db <dir> [--threads N] [--keys N] [--batch N] [--radius N] [--seconds S]
+//                      [--seed N] [--scenarios a,b,...] [--huge-pages off|transparent|explicit] [--verify-checksums 0|1] [--block-cache-mb N] [--secondary-cache-mb N] [--location-hints N] [--out file]
+//
+// cold_batch and cold_batch_no_readahead (not run by default) time the first radius batch against a
+// freshly opened world whose tables were just dropped from the page cache, with and without the
+// batch read-ahead, and report the blocks read and major page faults that batch took. POSIX only.
+//
+// Table count and value size are properties of the world being measured; both are reported in the
+// output so runs against different worlds can be told apart. leveldbminimal_worldgen makes worlds of
+// a given shape.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <functional>
+#include <utility>
+#include <filesystem>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#include "LevelDBMinimalApi.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint8_t kAABBVolumesTag = 0x77;
+constexpr uint8_t kMissTag = 0xFF; // Sorts after every real tag, so a miss still lands inside table ranges
+constexpr size_t kMaxSampledKeys = 1 << 20;
+
+struct BenchConfig {
+    std::string db;
+    int32_t threads = 1;
+    int32_t keys = 4096;   // Distinct keys sampled from the world
+    int32_t batch = 1;     // Keys per point lookup call
+    int32_t radius = 7;
+    double seconds = 2.0;  // Per scenario
+    uint64_t seed = 1;
+    int32_t hugePages = kHugePagesOff; // Requested; the report shows what the machine granted
+    DBOptions options;
+    std::string out;
+    std::vector<std::string> scenarios = { "point_hit", "point_miss", "radius_batch", "prefix_scan", "village_scan", "log_lookup", "refresh", "open" };
+};
+
+struct ScenarioResult {
+    std::string name;
+    bool skipped = false;
+    uint64_t ops = 0;
+    uint64_t keys = 0;
+    double seconds = 0;
+    std::vector<uint64_t> nanos;
+    bool cold = false; // Cold scenarios also report the two below, summed over every op
+    uint64_t blocksRead = 0;
+    uint64_t majorFaults = 0;
+};
+
+// A batch laid out the way BatchGetFlat takes it.
+struct FlatKeys {
+    std::vector<uint8_t> bytes;
+    std::vector<int32_t> offsets;
+    std::vector<int32_t> lengths;
+
+    void Clear() { bytes.clear(); offsets.clear(); lengths.clear(); }
+    void Add(const uint8_t* key, size_t len) {
+        offsets.push_back((int32_t)bytes.size());
+        lengths.push_back((int32_t)len);
+        bytes.insert(bytes.end(), key, key + len);
+    }
+    int32_t Count() const { return (int32_t)offsets.size(); }
+};
+
+static std::vector<std::string> g_sampled;
+static uint64_t g_sampledValueBytes = 0;
+static int32_t g_sampleCancel = 0;
+static thread_local uint64_t t_scanned = 0;
+
+static void CollectChunkKey(const uint8_t* key, int32_t keyLen, const uint8_t*, int32_t valLen) {
+    if (keyLen != 9 && keyLen != 13) return;
+    g_sampled.emplace_back((const char*)key, keyLen);
+    g_sampledValueBytes += valLen;
+    if (g_sampled.size() >= kMaxSampledKeys) g_sampleCancel = 1;
+}
+
+static void CountKey(const uint8_t*, int32_t, const uint8_t*, int32_t) { t_scanned++; }
+
+static void PutInt32(uint8_t* p, int32_t v) { std::memcpy(p, &v, 4); }
+static int32_t GetInt32(const uint8_t* p) { int32_t v; std::memcpy(&v, p, 4); return v; }
+
+// The plugin's query shape: every chunk within radius of center.
+static void AddRadiusBatch(FlatKeys& batch, const std::string& center, int32_t radius) {
+    auto p = (const uint8_t*)center.data();
+    uint8_t key[13];
+    std::memcpy(key, p, center.size());
+    for (int32_t dx = -radius; dx <= radius; dx++) {
+        for (int32_t dz = -radius; dz <= radius; dz++) {
+            PutInt32(key, GetInt32(p) + dx);
+            PutInt32(key + 4, GetInt32(p + 4) + dz);
+            batch.Add(key, center.size());
+        }
+    }
+}
+
+static bool ParseArgs(int argc, char** argv, BenchConfig& cfg) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n", argv[i]);
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--db") cfg.db = value;
+        else if (arg == "--threads") cfg.threads = std::max(1, std::atoi(value));
+        else if (arg == "--keys") cfg.keys = std::max(1, std::atoi(value));
+        else if (arg == "--batch") cfg.batch = std::max(1, std::atoi(value));
+        else if (arg == "--radius") cfg.radius = std::clamp(std::atoi(value), 0, 31);
+        else if (arg == "--seconds") cfg.seconds = std::max(0.01, std::atof(value));
+        else if (arg == "--seed") cfg.seed = std::strtoull(value, nullptr, 10);
+        else if (arg == "--out") cfg.out = value;
+        else if (arg == "--verify-checksums") cfg.options.verifyChecksums = std::atoi(value) != 0;
+        else if (arg == "--block-cache-mb") cfg.options.blockCacheBytes = (int64_t)std::atoll(value) << 20;
+        else if (arg == "--secondary-cache-mb") cfg.options.secondaryCacheBytes = (int64_t)std::atoll(value) << 20;
+        else if (arg == "--location-hints") cfg.options.locationHints = std::atoi(value);
+        else if (arg == "--huge-pages") {
+            std::string_view mode = value;
+            if (mode == "off") cfg.hugePages = kHugePagesOff;
+            else if (mode == "transparent") cfg.hugePages = kHugePagesTransparent;
+            else if (mode == "explicit") cfg.hugePages = kHugePagesExplicit;
+            else {
+                std::fprintf(stderr, "unknown huge page mode %s\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--scenarios") {
+            cfg.scenarios.clear();
+            std::string_view list = value;
+            while (!list.empty()) {
+                size_t comma = list.find(',');
+                cfg.scenarios.emplace_back(list.substr(0, comma));
+                list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+            }
+        }
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i - 1]);
+            return false;
+        }
+    }
+    if (cfg.db.empty()) {
+        std::fprintf(stderr, "usage: leveldbminimal_bench --db <dir> [--threads N] [--keys N] [--batch N] [--radius N] [--seconds S] [--seed N] [--scenarios a,b,...] [--huge-pages off|transparent|explicit] [--verify-checksums 0|1] [--block-cache-mb N] [--secondary-cache-mb N] [--location-hints N] [--out file]\n");
+        return false;
+    }
+    return true;
+}
+
+// Runs op on every thread until the time budget is spent. op returns the number of keys it handled.
+static ScenarioResult RunScenario(const std::string& name, const BenchConfig& cfg, const std::function<uint64_t(int32_t, std::mt19937_64&)>& op) {
+    ScenarioResult result;
+    result.name = name;
+    std::vector<std::vector<uint64_t>> nanos(cfg.threads);
+    std::vector<uint64_t> keys(cfg.threads, 0);
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(cfg.seconds));
+
+    std::vector<std::thread> workers;
+    for (int32_t t = 0; t < cfg.threads; t++) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 rng(cfg.seed + t);
+            Clock::time_point now;
+            do {
+                auto opStart = Clock::now();
+                keys[t] += op(t, rng);
+                now = Clock::now();
+                nanos[t].push_back((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - opStart).count());
+            } while (now < end);
+            });
+    }
+    for (auto& w : workers) w.join();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (int32_t t = 0; t < cfg.threads; t++) {
+        result.keys += keys[t];
+        result.nanos.insert(result.nanos.end(), nanos[t].begin(), nanos[t].end());
+    }
+    result.ops = result.nanos.size();
+    return result;
+}
+
+static double Percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+    return sorted[index] / 1000.0;
+}
+
+static std::string JsonString(std::string_view s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if ((unsigned char)c < 0x20) { char buf[8]; std::snprintf(buf, sizeof(buf), "\\u%04x", c); out += buf; }
+        else out += c;
+    }
+    return out + "\"";
+}
+
+static void WriteReport(FILE* f, const BenchConfig& cfg, int32_t hugePages, const TableSetStats& tables, const BlockCacheStats& cache, double meanValueBytes, std::vector<ScenarioResult>& results) {
+    static constexpr const char* kHugePageNames[] = { "off", "transparent", "explicit" };
+    std::fprintf(f, "{\n  \"db\": %s,\n  \"threads\": %d,\n  \"keys\": %d,\n  \"batch\": %d,\n  \"radius\": %d,\n  \"huge_pages\": \"%s\",\n  \"verify_checksums\": %s,\n  \"block_cache_bytes\": %lld,\n  \"secondary_cache_bytes\": %lld,\n  \"location_hints\": %d,\n",
+        JsonString(cfg.db).c_str(), cfg.threads, cfg.keys, cfg.batch, cfg.radius, kHugePageNames[hugePages], cfg.options.verifyChecksums ? "true" : "false",
+        (long long)cfg.options.blockCacheBytes, (long long)cfg.options.secondaryCacheBytes, cfg.options.locationHints);
+    // Cumulative over every scenario that ran against the main handle since the last cold scenario reopened it.
+    std::fprintf(f, "  \"block_cache\": {\"primary_bytes\": %llu, \"secondary_bytes\": %llu, \"secondary_hits\": %llu, \"secondary_misses\": %llu, "
+        "\"demoted_blocks\": %llu, \"demoted_bytes\": %llu, \"packed_bytes\": %llu, \"hint_hits\": %llu, \"hint_misses\": %llu},\n",
+        (unsigned long long)cache.primaryBytes, (unsigned long long)cache.secondaryBytes, (unsigned long long)cache.secondaryHits,
+        (unsigned long long)cache.secondaryMisses, (unsigned long long)cache.demotedBlocks, (unsigned long long)cache.demotedBytes,
+        (unsigned long long)cache.packedBytes, (unsigned long long)cache.hintHits, (unsigned long long)cache.hintMisses);
+    std::fprintf(f, "  \"tables\": %u,\n  \"value_bytes_mean\": %.1f,\n  \"scenarios\": [", tables.activeTables, meanValueBytes);
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        std::fprintf(f, "%s\n    {\"name\": %s", i ? "," : "", JsonString(r.name).c_str());
+        if (r.skipped) {
+            std::fprintf(f, ", \"skipped\": true}");
+            continue;
+        }
+        std::sort(r.nanos.begin(), r.nanos.end());
+        double mean = 0;
+        for (uint64_t n : r.nanos) mean += n;
+        mean = r.ops ? mean / r.ops / 1000.0 : 0;
+        std::fprintf(f, ", \"ops\": %llu, \"keys\": %llu, \"seconds\": %.3f, \"ops_per_sec\": %.1f, \"keys_per_sec\": %.1f, "
+            "\"mean_us\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f",
+            (unsigned long long)r.ops, (unsigned long long)r.keys, r.seconds, r.ops / r.seconds, r.keys / r.seconds,
+            mean, Percentile(r.nanos, 0.50), Percentile(r.nanos, 0.99), r.nanos.empty() ? 0.0 : r.nanos.back() / 1000.0);
+        if (r.cold) {
+            std::fprintf(f, ", \"blocks_read_per_op\": %.1f, \"major_faults_per_op\": %.1f",
+                r.ops ? (double)r.blocksRead / r.ops : 0.0, r.ops ? (double)r.majorFaults / r.ops : 0.0);
+        }
+        std::fprintf(f, "}");
+    }
+    std::fprintf(f, "\n  ]\n}\n");
+}
+
+#ifndef _WIN32
+// Asks the kernel to drop the world's tables from the page cache. Only pages no mapping holds go, so
+// every handle on the world has to be closed first.
+static void DropTablesFromPageCache(const std::string& dir) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.path().extension() != ".ldb") continue;
+        int fd = open(entry.path().c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+static uint64_t MajorFaults() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)usage.ru_majflt;
+}
+#endif
+
+static uint64_t RunBatch(BedrockDB* db, const FlatKeys& batch) {
+    uint8_t* block = nullptr;
+    int32_t count = batch.Count();
+    std::vector<int32_t> offsets(count), lengths(count);
+    std::vector<uint8_t> found(count);
+    BatchGetFlat(db, batch.bytes.data(), batch.offsets.data(), batch.lengths.data(), count,
+        &block, offsets.data(), lengths.data(), found.data(), nullptr, 0);
+    FreeBuffer(block);
+    return count;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    if (!ParseArgs(argc, argv, cfg)) return 2;
+    int32_t hugePages = SetHugePages(cfg.hugePages);
+
+    BedrockDB* db = OpenDBWithOptions(cfg.db.c_str(), &cfg.options);
+    if (!db) {
+        std::fprintf(stderr, "failed to open %s\n", cfg.db.c_str());
+        return 1;
+    }
+    TableSetStats tables{};
+    GetTableSetStats(db, &tables);
+
+    // Sample hit keys from the AABB volume records, the keys the plugin looks up most.
+    const uint8_t suffix = kAABBVolumesTag;
+    IterateDB(db, nullptr, 0, &suffix, 1, CollectChunkKey, &g_sampleCancel, 0);
+    if (g_sampled.empty()) {
+        std::fprintf(stderr, "no chunk keys with tag 0x%02x in %s\n", kAABBVolumesTag, cfg.db.c_str());
+        CloseDB(db);
+        return 1;
+    }
+    double meanValueBytes = (double)g_sampledValueBytes / g_sampled.size();
+    std::mt19937_64 sampleRng(cfg.seed);
+    std::shuffle(g_sampled.begin(), g_sampled.end(), sampleRng);
+    if (g_sampled.size() > (size_t)cfg.keys) g_sampled.resize(cfg.keys);
+    std::vector<std::string> missKeys = g_sampled;
+    for (auto& key : missKeys) key.back() = (char)kMissTag;
+
+    auto pointLookup = [&](const std::vector<std::string>& pool) {
+        return [&, pool = &pool](int32_t, std::mt19937_64& rng) {
+            thread_local FlatKeys batch;
+            batch.Clear();
+            for (int32_t i = 0; i < cfg.batch; i++) {
+                auto& key = (*pool)[rng() % pool->size()];
+                batch.Add((const uint8_t*)key.data(), key.size());
+            }
+            return RunBatch(db, batch);
+            };
+        };
+
+    std::vector<ScenarioResult> results;
+    for (auto& name : cfg.scenarios) {
+        if (name == "point_hit") {
+            results.push_back(RunScenario(name, cfg, pointLookup(g_sampled)));
+        }
+        else if (name == "point_miss") {
+            results.push_back(RunScenario(name, cfg, pointLookup(missKeys)));
+        }
+        else if (name == "radius_batch") {
+            // The plugin's query shape: every chunk within radius of a known chunk.
+            results.push_back(RunScenario(name, cfg, [&](int32_t, std::mt19937_64& rng) {
+                thread_local FlatKeys batch;
+                batch.Clear();
+                AddRadiusBatch(batch, g_sampled[rng() % g_sampled.size()], cfg.radius);
+                return RunBatch(db, batch);
+                }));
+        }
+        else if (name == "prefix_scan") {
+            // Everything stored for one chunk: the key minus its tag byte.
+            results.push_back(RunScenario(name, cfg, [&](int32_t, std::mt19937_64& rng) {
+                auto& key = g_sampled[rng() % g_sampled.size()];
+                t_scanned = 0;
+                IterateDB(db, (const uint8_t*)key.data(), (int32_t)key.size() - 1, nullptr, 0, CountKey, nullptr, 0);
+                return t_scanned;
+                }));
+        }
+        else if (name == "village_scan") {
+            static constexpr char kVillagePrefix[] = "VILLAGE_";
+            results.push_back(RunScenario(name, cfg, [&](int32_t, std::mt19937_64&) {
+                t_scanned = 0;
+                IterateDB(db, (const uint8_t*)kVillagePrefix, sizeof(kVillagePrefix) - 1, nullptr, 0, CountKey, nullptr, 0);
+                return t_scanned;
+                }));
+        }
+        else if (name == "log_lookup") {
+            LogSession* session = OpenLogSessionWithOptions(cfg.db.c_str(), &cfg.options);
+            if (!session) {
+                ScenarioResult skipped;
+                skipped.name = name;
+                skipped.skipped = true;
+                results.push_back(std::move(skipped));
+                continue;
+            }
+            results.push_back(RunScenario(name, cfg, [&](int32_t, std::mt19937_64& rng) {
+                thread_local FlatKeys batch;
+                batch.Clear();
+                for (int32_t i = 0; i < cfg.batch; i++) {
+                    auto& key = g_sampled[rng() % g_sampled.size()];
+                    batch.Add((const uint8_t*)key.data(), key.size());
+                }
+                uint8_t* block = nullptr;
+                int32_t count = batch.Count();
+                std::vector<int32_t> offsets(count), lengths(count);
+                std::vector<uint8_t> found(count);
+                BatchGetSessionFlat(session, batch.bytes.data(), batch.offsets.data(), batch.lengths.data(), count,
+                    &block, offsets.data(), lengths.data(), found.data(), nullptr, 0);
+                FreeBuffer(block);
+                return (uint64_t)count;
+                }));
+            CloseLogSession(session);
+        }
+        else if (name == "refresh") {
+            // A steady-state refresh: nothing changed on disk, so this is the cost of finding that out.
+            LogSession* session = OpenLogSessionWithOptions(cfg.db.c_str(), &cfg.options);
+            results.push_back(RunScenario(name, cfg, [&](int32_t, std::mt19937_64&) {
+                UpdateDB(db, cfg.db.c_str());
+                if (session) UpdateLogSession(session, cfg.db.c_str());
+                return (uint64_t)0;
+                }));
+            if (session) CloseLogSession(session);
+        }
+        else if (name == "cold_batch" || name == "cold_batch_no_readahead") {
+            ScenarioResult result;
+            result.name = name;
+#ifdef _WIN32
+            result.skipped = true;
+#else
+            // The main handle's mappings would keep the tables resident, so it is closed meanwhile.
+            CloseDB(db);
+            DBOptions options = cfg.options;
+            options.disableReadAhead = name == "cold_batch_no_readahead";
+            std::mt19937_64 rng(cfg.seed);
+            FlatKeys batch;
+            auto start = Clock::now();
+            auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(cfg.seconds));
+            do {
+                DropTablesFromPageCache(cfg.db);
+                BedrockDB* cold = OpenDBWithOptions(cfg.db.c_str(), &options);
+                if (!cold) break;
+                batch.Clear();
+                AddRadiusBatch(batch, g_sampled[rng() % g_sampled.size()], cfg.radius);
+                DBStats before{}, after{};
+                GetStats(&before);
+                uint64_t faults = MajorFaults();
+                auto opStart = Clock::now();
+                result.keys += RunBatch(cold, batch);
+                result.nanos.push_back((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opStart).count());
+                result.majorFaults += MajorFaults() - faults;
+                GetStats(&after);
+                result.blocksRead += after.counters[kStatBlocksRead] - before.counters[kStatBlocksRead];
+                CloseDB(cold);
+            } while (Clock::now() < end);
+            result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            result.ops = result.nanos.size();
+            result.cold = true;
+            db = OpenDBWithOptions(cfg.db.c_str(), &cfg.options);
+            if (!db) {
+                std::fprintf(stderr, "failed to reopen %s\n", cfg.db.c_str());
+                return 1;
+            }
+#endif
+            results.push_back(std::move(result));
+        }
+        else if (name == "open") {
+            results.push_back(RunScenario(name, cfg, [&](int32_t, std::mt19937_64&) {
+                CloseDB(OpenDBWithOptions(cfg.db.c_str(), &cfg.options));
+                return (uint64_t)0;
+                }));
+        }
+        else {
+            std::fprintf(stderr, "unknown scenario %s\n", name.c_str());
+            CloseDB(db);
+            return 2;
+        }
+    }
+    BlockCacheStats cache{};
+    GetBlockCacheStats(db, &cache);
+    CloseDB(db);
+
+    FILE* f = cfg.out.empty() ? stdout : std::fopen(cfg.out.c_str(), "w");
+    if (!f) {
+        std::fprintf(stderr, "failed to write %s\n", cfg.out.c_str());
+        return 1;
+    }
+    WriteReport(f, cfg, hugePages, tables, cache, meanValueBytes, results);
+    if (f != stdout) std::fclose(f);
+    return 0;
+}
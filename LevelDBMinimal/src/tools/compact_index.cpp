@@ -0,0 +1,137 @@
+// leveldbminimal_compact_index: builds the read-only chunk index of a world that no longer changes,
+// for DBOptions.chunkIndexPath.
+//
+// leveldbminimal_compact_index --db <dir> --tag N --out <file> [--verify 0|1]
+//
+// The index covers every live chunk key with the given tag (decimal or 0x hex) and holds their
+// values, so lookups of those keys never touch the tables. The db only uses it while its tables
+// are exactly the ones it was built from. --verify reopens the world with the index and checks
+// every key of the tag against a plain open.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+
+#include "LevelDBMinimalApi.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int32_t kVerifyBatch = 4096;
+
+struct Record {
+    std::string key, value;
+};
+
+static uint8_t g_tag = 0;
+static std::vector<Record> g_records;
+static int32_t g_noCancel = 0;
+
+// Mirrors the library's notion of a chunk key of one tag: x, z[, dim], tag[, sub-chunk index].
+static bool IsChunkKeyOfTag(const uint8_t* key, int32_t len, uint8_t tag) {
+    if (len == 9 || len == 13) return key[len - 1] == tag;
+    if (len == 10 || len == 14) return key[len - 2] == tag;
+    return false;
+}
+
+static void CollectRecord(const uint8_t* key, int32_t keyLen, const uint8_t* val, int32_t valLen) {
+    if (!IsChunkKeyOfTag(key, keyLen, g_tag)) return;
+    g_records.push_back({ std::string((const char*)key, (size_t)keyLen), std::string((const char*)val, (size_t)valLen) });
+}
+
+// Looks every record up through the index and compares; returns the number of mismatches, or -1
+// if an open failed. indexedKeys is how many keys the db says its attached index holds.
+static int64_t Verify(const std::string& db, const std::string& out, uint64_t& indexedKeys) {
+    BedrockDB* plain = OpenDB(db.c_str());
+    if (!plain) return -1;
+    IterateDB(plain, nullptr, 0, nullptr, 0, CollectRecord, &g_noCancel, 0);
+    CloseDB(plain);
+
+    DBOptions options;
+    options.chunkIndexPath = out.c_str();
+    BedrockDB* indexed = OpenDBWithOptions(db.c_str(), &options);
+    if (!indexed) return -1;
+    TableSetStats tables{};
+    GetTableSetStats(indexed, &tables);
+    indexedKeys = tables.chunkIndexKeys;
+    int64_t mismatches = 0;
+    for (size_t start = 0; start < g_records.size(); start += kVerifyBatch) {
+        int32_t count = (int32_t)std::min<size_t>(kVerifyBatch, g_records.size() - start);
+        std::string flat;
+        std::vector<int32_t> offsets(count), lengths(count), dataOffsets(count), dataLengths(count);
+        std::vector<uint8_t> found(count);
+        for (int32_t i = 0; i < count; i++) {
+            offsets[i] = (int32_t)flat.size();
+            lengths[i] = (int32_t)g_records[start + i].key.size();
+            flat += g_records[start + i].key;
+        }
+        uint8_t* block = nullptr;
+        BatchGetFlat(indexed, (const uint8_t*)flat.data(), offsets.data(), lengths.data(), count, &block, dataOffsets.data(), dataLengths.data(), found.data(), nullptr, 0);
+        for (int32_t i = 0; i < count; i++) {
+            const std::string& want = g_records[start + i].value;
+            if (!found[i] || (size_t)dataLengths[i] != want.size() || std::memcmp(block + dataOffsets[i], want.data(), want.size()) != 0) mismatches++;
+        }
+        FreeBuffer(block);
+    }
+    CloseDB(indexed);
+    return mismatches;
+}
+
+int main(int argc, char** argv) {
+    std::string db, out;
+    long tag = -1;
+    bool verify = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n", argv[i]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (arg == "--db") db = value;
+        else if (arg == "--out") out = value;
+        else if (arg == "--tag") tag = std::strtol(value, nullptr, 0);
+        else if (arg == "--verify") verify = std::atoi(value) != 0;
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i - 1]);
+            return 2;
+        }
+    }
+    if (db.empty() || out.empty() || tag < 0 || tag > 0xFF) {
+        std::fprintf(stderr, "usage: leveldbminimal_compact_index --db <dir> --tag N --out <file> [--verify 0|1]\n");
+        return 2;
+    }
+
+    auto start = Clock::now();
+    int64_t keys = BuildChunkIndex(db.c_str(), (uint8_t)tag, out.c_str());
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (keys < 0) {
+        std::fprintf(stderr, "failed to build the chunk index of %s\n", db.c_str());
+        return 1;
+    }
+    std::error_code ec;
+    uint64_t bytes = (uint64_t)std::filesystem::file_size(out, ec);
+    std::printf("indexed %lld keys with tag 0x%02lx into %s (%llu bytes) in %.2f s\n", (long long)keys, tag, out.c_str(), (unsigned long long)bytes, seconds);
+
+    if (verify) {
+        g_tag = (uint8_t)tag;
+        uint64_t indexed = 0;
+        int64_t mismatches = Verify(db, out, indexed);
+        if (mismatches < 0) {
+            std::fprintf(stderr, "verify: failed to open %s\n", db.c_str());
+            return 1;
+        }
+        if (indexed != (uint64_t)keys || mismatches > 0) {
+            std::fprintf(stderr, "verify: index %s, %lld mismatches\n", indexed ? "in use" : "not in use", (long long)mismatches);
+            return 1;
+        }
+        std::printf("verified %zu keys\n", g_records.size());
+    }
+    return 0;
+}
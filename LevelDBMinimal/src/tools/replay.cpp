@@ -0,0 +1,480 @@
+// leveldbminimal_replay: replays a call recording (StartRecording) against a db directory and
+// reports the latency of every op next to the latency it had when it was recorded.
+//
+// leveldbminimal_replay --trace <file> --db <dir> [--speed recorded|max] [--out file]
+//                       [--snapshot file] [--chunk-index file]
+//
+// Calls run one at a time in the order they started. At recorded speed each call waits for its
+// original start offset; at max speed they run back to back. Every path in the recording is
+// replaced by --db, or by --snapshot and --chunk-index for opens that were given a metadata
+// snapshot or a chunk index; without those options such opens replay without them. The tracker is replayed by doing its work inline: each recorded tracker query
+// becomes UpdateDB, UpdateLogSession and QueryChunkBoxes on the tracker's own handles.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <unordered_map>
+
+#include "LevelDBMinimalApi.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Mirrors the recorder in LevelDBMinimal.cpp; only ever append ops.
+constexpr char kRecordMagic[8] = { 'L', 'D', 'B', 'M', 'R', 'E', 'C', '1' };
+constexpr uint32_t kRecordVersion = 7;
+constexpr int32_t kDefaultRingCapacity = 4096;
+
+enum RecordOp : uint8_t {
+    kRecOpenDB = 1, kRecUpdateDB, kRecCloseDB, kRecIterateDB, kRecBatchGetFlat, kRecBatchGetStreaming, kRecPrefetch,
+    kRecPrefetchChunkRect, kRecOpenLogSession, kRecUpdateLogSession, kRecCloseLogSession, kRecBatchGetSessionFlat,
+    kRecCreateResultRing, kRecDestroyResultRing, kRecQueryChunkBoxes, kRecStartTracker, kRecSetPosition,
+    kRecTrackerQuery, kRecStopTracker, kRecOpCount,
+};
+
+// The op fields of every op, in order: i handle id, n zigzag int, b length-prefixed bytes,
+// k key list (count, then length-prefixed keys), w wave list (count, then ints), c id of the
+// handle the call returned.
+struct OpInfo {
+    const char* name;
+    const char* fields;
+};
+
+constexpr OpInfo kOps[kRecOpCount] = {
+    { "", "" },
+    { "OpenDB", "bnnnnnnbbnc" },
+    { "UpdateDB", "i" },
+    { "CloseDB", "i" },
+    { "IterateDB", "ibb" },
+    { "BatchGetFlat", "ik" },
+    { "BatchGetStreaming", "ikw" },
+    { "Prefetch", "ik" },
+    { "PrefetchChunkRect", "innnnnn" },
+    { "OpenLogSession", "bnc" },
+    { "UpdateLogSession", "i" },
+    { "CloseLogSession", "i" },
+    { "BatchGetSessionFlat", "ik" },
+    { "CreateResultRing", "nc" },
+    { "DestroyResultRing", "i" },
+    { "QueryChunkBoxes", "iiinnnn" },
+    { "StartTracker", "bnnnnnnnnbbnc" },
+    { "SetPosition", "innn" },
+    { "TrackerQuery", "innn" },
+    { "StopTracker", "i" },
+};
+
+// A batch laid out the way the Batch* exports take it.
+struct FlatKeys {
+    std::vector<uint8_t> bytes;
+    std::vector<int32_t> offsets;
+    std::vector<int32_t> lengths;
+
+    void Add(const uint8_t* key, size_t len) {
+        offsets.push_back((int32_t)bytes.size());
+        lengths.push_back((int32_t)len);
+        bytes.insert(bytes.end(), key, key + len);
+    }
+    int32_t Count() const { return (int32_t)offsets.size(); }
+};
+
+struct Call {
+    RecordOp op;
+    uint32_t thread;
+    uint64_t startMicros;
+    uint64_t durationNanos;
+    int64_t status;
+    std::vector<uint64_t> ids;
+    std::vector<int64_t> ints;
+    std::vector<std::string> bytes;
+    FlatKeys keys;
+    std::vector<int32_t> waves;
+    uint64_t created = 0;
+};
+
+class TraceReader {
+public:
+    TraceReader(const uint8_t* p, const uint8_t* end) : p_(p), end_(end) {}
+
+    bool AtEnd() const { return p_ >= end_; }
+
+    bool Varint(uint64_t& v) {
+        v = 0;
+        for (int shift = 0; shift <= 63 && p_ < end_; shift += 7) {
+            uint8_t b = *p_++;
+            v |= uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+    bool ZigZag(int64_t& v) {
+        uint64_t u;
+        if (!Varint(u)) return false;
+        v = int64_t(u >> 1) ^ -int64_t(u & 1);
+        return true;
+    }
+    bool Bytes(const uint8_t*& data, size_t& len) {
+        uint64_t n;
+        if (!Varint(n) || n > uint64_t(end_ - p_)) return false;
+        data = p_; len = (size_t)n;
+        p_ += n;
+        return true;
+    }
+
+    bool ReadCall(Call& call) {
+        uint8_t op = *p_++;
+        if (op == 0 || op >= kRecOpCount) return false;
+        call.op = (RecordOp)op;
+        uint64_t thread;
+        if (!Varint(thread) || !Varint(call.startMicros) || !Varint(call.durationNanos) || !ZigZag(call.status)) return false;
+        call.thread = (uint32_t)thread;
+        for (const char* f = kOps[op].fields; *f; ++f) {
+            uint64_t u; int64_t n; const uint8_t* data; size_t len;
+            switch (*f) {
+            case 'i': if (!Varint(u)) return false; call.ids.push_back(u); break;
+            case 'c': if (!Varint(call.created)) return false; break;
+            case 'n': if (!ZigZag(n)) return false; call.ints.push_back(n); break;
+            case 'b': if (!Bytes(data, len)) return false; call.bytes.emplace_back((const char*)data, len); break;
+            case 'k':
+                if (!Varint(u)) return false;
+                for (uint64_t i = 0; i < u; ++i) {
+                    if (!Bytes(data, len)) return false;
+                    call.keys.Add(data, len);
+                }
+                break;
+            case 'w':
+                if (!ZigZag(n) || n < 0) return false;
+                for (int64_t i = 0; i < n; ++i) {
+                    int64_t end;
+                    if (!ZigZag(end)) return false;
+                    call.waves.push_back((int32_t)end);
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+};
+
+struct ReplayTracker {
+    BedrockDB* db = nullptr;
+    LogSession* session = nullptr;
+    ResultRing* ring = nullptr;
+    int32_t radius = 0;
+    DBOptions options; // Reused when the session has to be reopened
+};
+
+struct OpLatencies {
+    std::vector<uint64_t> recorded;
+    std::vector<uint64_t> replayed;
+};
+
+static void IgnoreKey(const uint8_t*, int32_t, const uint8_t*, int32_t) {}
+static void IgnoreWave(int32_t, int32_t, const uint8_t*, const int32_t*, const int32_t*, const uint8_t*) {}
+
+// Replays calls against one db directory. Handles first seen in a call rather than an open (the
+// recording began after the host opened them) are opened on demand.
+class Replayer {
+public:
+    Replayer(std::string dir, std::string snapshotPath, std::string chunkIndexPath)
+        : dir_(std::move(dir)), snapshotPath_(std::move(snapshotPath)), chunkIndexPath_(std::move(chunkIndexPath)) {}
+    ~Replayer() {
+        for (auto& [id, t] : trackers_) CloseTracker(t);
+        for (auto& [id, ring] : rings_) DestroyResultRing(ring);
+        for (auto& [id, session] : sessions_) CloseLogSession(session);
+        for (auto& [id, db] : dbs_) CloseDB(db);
+    }
+
+    void Run(const Call& c) {
+        switch (c.op) {
+        case kRecOpenDB: {
+            DBOptions options;
+            if (c.ints[0] > 0) options.maxOpenTables = (int32_t)c.ints[0];
+            options.preopenTables = (int32_t)c.ints[1];
+            options.verifyChecksums = (int32_t)c.ints[2];
+            options.blockCacheBytes = c.ints[3];
+            options.secondaryCacheBytes = c.ints[4];
+            options.locationHints = (int32_t)c.ints[5];
+            options.disableReadAhead = (int32_t)c.ints[6];
+            SetPaths(options, c.bytes[1], c.bytes[2]);
+            if (BedrockDB* db = OpenDBWithOptions(dir_.c_str(), &options)) Replace(dbs_, c.created, db, CloseDB);
+            break;
+        }
+        case kRecUpdateDB: UpdateDB(Db(c.ids[0]), dir_.c_str()); break;
+        case kRecCloseDB: Close(dbs_, c.ids[0], CloseDB); break;
+        case kRecIterateDB:
+            IterateDB(Db(c.ids[0]), (const uint8_t*)c.bytes[0].data(), (int32_t)c.bytes[0].size(),
+                (const uint8_t*)c.bytes[1].data(), (int32_t)c.bytes[1].size(), IgnoreKey, nullptr, 0);
+            break;
+        case kRecBatchGetFlat: Batch(c.keys, [&](auto... out) { return BatchGetFlat(Db(c.ids[0]), out...); }); break;
+        case kRecBatchGetStreaming:
+            if (c.keys.Count() > 0 && !c.waves.empty()) {
+                BatchGetStreaming(Db(c.ids[0]), c.keys.bytes.data(), c.keys.offsets.data(), c.keys.lengths.data(), c.keys.Count(),
+                    c.waves.data(), (int32_t)c.waves.size(), IgnoreWave, nullptr, 0);
+            }
+            break;
+        case kRecPrefetch:
+            Prefetch(Db(c.ids[0]), c.keys.bytes.data(), c.keys.offsets.data(), c.keys.lengths.data(), c.keys.Count());
+            break;
+        case kRecPrefetchChunkRect:
+            PrefetchChunkRect(Db(c.ids[0]), (int32_t)c.ints[0], (int32_t)c.ints[1], (int32_t)c.ints[2], (int32_t)c.ints[3], (int32_t)c.ints[4], (uint8_t)c.ints[5]);
+            break;
+        case kRecOpenLogSession: {
+            DBOptions options;
+            options.verifyChecksums = (int32_t)c.ints[0];
+            if (LogSession* session = OpenLogSessionWithOptions(dir_.c_str(), &options)) Replace(sessions_, c.created, session, CloseLogSession);
+            break;
+        }
+        case kRecUpdateLogSession: UpdateLogSession(Session(c.ids[0]), dir_.c_str()); break;
+        case kRecCloseLogSession: Close(sessions_, c.ids[0], CloseLogSession); break;
+        case kRecBatchGetSessionFlat: Batch(c.keys, [&](auto... out) { return BatchGetSessionFlat(Session(c.ids[0]), out...); }); break;
+        case kRecCreateResultRing:
+            if (ResultRing* ring = CreateResultRing((int32_t)c.ints[0])) Replace(rings_, c.created, ring, DestroyResultRing);
+            break;
+        case kRecDestroyResultRing: Close(rings_, c.ids[0], DestroyResultRing); break;
+        case kRecQueryChunkBoxes:
+            QueryChunkBoxes(Db(c.ids[0]), Session(c.ids[1]), (int32_t)c.ints[0], (int32_t)c.ints[1], (int32_t)c.ints[2], (int32_t)c.ints[3],
+                Ring(c.ids[2]), nullptr, 0);
+            break;
+        case kRecStartTracker: {
+            DBOptions options;
+            if (c.ints[0] > 0) options.maxOpenTables = (int32_t)c.ints[0];
+            options.preopenTables = (int32_t)c.ints[1];
+            options.verifyChecksums = (int32_t)c.ints[4];
+            options.blockCacheBytes = c.ints[5];
+            options.secondaryCacheBytes = c.ints[6];
+            options.locationHints = (int32_t)c.ints[7];
+            options.disableReadAhead = (int32_t)c.ints[8];
+            SetPaths(options, c.bytes[1], c.bytes[2]);
+            ReplayTracker t;
+            t.options = options;
+            t.db = OpenDBWithOptions(dir_.c_str(), &options);
+            if (!t.db) break;
+            t.session = OpenLogSessionWithOptions(dir_.c_str(), &options);
+            t.ring = CreateResultRing((int32_t)c.ints[3]);
+            t.radius = (int32_t)c.ints[2];
+            if (auto it = trackers_.find(c.created); it != trackers_.end()) CloseTracker(it->second);
+            trackers_[c.created] = t;
+            break;
+        }
+        case kRecSetPosition: break; // Only marks when the player moved; the work shows up as TrackerQuery
+        case kRecTrackerQuery: {
+            ReplayTracker& t = TrackerFor(c.ids[0]);
+            if (!t.db) break;
+            UpdateDB(t.db, dir_.c_str());
+            if (t.session) UpdateLogSession(t.session, dir_.c_str());
+            else t.session = OpenLogSessionWithOptions(dir_.c_str(), &t.options);
+            QueryChunkBoxes(t.db, t.session, (int32_t)c.ints[0], (int32_t)c.ints[1], t.radius, (int32_t)c.ints[2], t.ring, nullptr, 0);
+            break;
+        }
+        case kRecStopTracker:
+            if (auto it = trackers_.find(c.ids[0]); it != trackers_.end()) {
+                CloseTracker(it->second);
+                trackers_.erase(it);
+            }
+            break;
+        default: break;
+        }
+    }
+
+private:
+    // Stands the replay's own files in for the paths an open was recorded with.
+    void SetPaths(DBOptions& options, const std::string& recordedSnapshot, const std::string& recordedChunkIndex) {
+        if (!recordedSnapshot.empty()) {
+            if (!snapshotPath_.empty()) options.snapshotPath = snapshotPath_.c_str();
+            else Warn(warnedSnapshot_, "a metadata snapshot", "--snapshot");
+        }
+        if (!recordedChunkIndex.empty()) {
+            if (!chunkIndexPath_.empty()) options.chunkIndexPath = chunkIndexPath_.c_str();
+            else Warn(warnedChunkIndex_, "a chunk index", "--chunk-index");
+        }
+    }
+
+    static void Warn(bool& warned, const char* what, const char* option) {
+        if (warned) return;
+        warned = true;
+        std::fprintf(stderr, "the recording opened the db with %s; pass %s to replay with one\n", what, option);
+    }
+
+    template <typename T, typename Closer>
+    static void Replace(std::unordered_map<uint64_t, T*>& map, uint64_t id, T* handle, Closer close) {
+        auto [it, added] = map.try_emplace(id, handle);
+        if (!added) { close(it->second); it->second = handle; }
+    }
+
+    template <typename T, typename Closer>
+    static void Close(std::unordered_map<uint64_t, T*>& map, uint64_t id, Closer close) {
+        auto it = map.find(id);
+        if (it == map.end()) return;
+        close(it->second);
+        map.erase(it);
+    }
+
+    static void CloseTracker(ReplayTracker& t) {
+        DestroyResultRing(t.ring);
+        CloseLogSession(t.session);
+        CloseDB(t.db);
+        t = {};
+    }
+
+    template <typename Func>
+    static void Batch(const FlatKeys& keys, Func&& call) {
+        int32_t count = keys.Count();
+        if (count == 0) return;
+        uint8_t* block = nullptr;
+        std::vector<int32_t> offsets(count), lengths(count);
+        std::vector<uint8_t> found(count);
+        call(keys.bytes.data(), keys.offsets.data(), keys.lengths.data(), count, &block, offsets.data(), lengths.data(), found.data(), (int32_t*)nullptr, (int64_t)0);
+        FreeBuffer(block);
+    }
+
+    BedrockDB* Db(uint64_t id) {
+        if (id == 0) return nullptr;
+        auto [it, added] = dbs_.try_emplace(id, nullptr);
+        if (added) it->second = OpenDB(dir_.c_str());
+        return it->second;
+    }
+    LogSession* Session(uint64_t id) {
+        if (id == 0) return nullptr;
+        auto [it, added] = sessions_.try_emplace(id, nullptr);
+        if (added) it->second = OpenLogSession(dir_.c_str());
+        return it->second;
+    }
+    ResultRing* Ring(uint64_t id) {
+        if (id == 0) return nullptr;
+        auto [it, added] = rings_.try_emplace(id, nullptr);
+        if (added) it->second = CreateResultRing(kDefaultRingCapacity);
+        return it->second;
+    }
+    ReplayTracker& TrackerFor(uint64_t id) {
+        auto [it, added] = trackers_.try_emplace(id);
+        if (added) {
+            it->second.db = OpenDB(dir_.c_str());
+            it->second.session = OpenLogSession(dir_.c_str());
+            it->second.ring = CreateResultRing(kDefaultRingCapacity);
+            it->second.radius = 7;
+        }
+        return it->second;
+    }
+
+    std::string dir_;
+    std::string snapshotPath_;
+    std::string chunkIndexPath_;
+    bool warnedSnapshot_ = false;
+    bool warnedChunkIndex_ = false;
+    std::unordered_map<uint64_t, BedrockDB*> dbs_;
+    std::unordered_map<uint64_t, LogSession*> sessions_;
+    std::unordered_map<uint64_t, ResultRing*> rings_;
+    std::unordered_map<uint64_t, ReplayTracker> trackers_;
+};
+
+static double Percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+    return sorted[index] / 1000.0;
+}
+
+static void WriteLatencies(FILE* f, const char* name, std::vector<uint64_t>& nanos) {
+    std::sort(nanos.begin(), nanos.end());
+    double mean = 0;
+    for (uint64_t n : nanos) mean += n;
+    mean = nanos.empty() ? 0 : mean / nanos.size() / 1000.0;
+    std::fprintf(f, "\"%s\": {\"mean_us\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f}",
+        name, mean, Percentile(nanos, 0.50), Percentile(nanos, 0.99), nanos.empty() ? 0.0 : nanos.back() / 1000.0);
+}
+
+int main(int argc, char** argv) {
+    std::string tracePath, dir, outPath, snapshotPath, chunkIndexPath;
+    bool recordedSpeed = false;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view arg = argv[i];
+        if (arg == "--trace") tracePath = argv[i + 1];
+        else if (arg == "--db") dir = argv[i + 1];
+        else if (arg == "--out") outPath = argv[i + 1];
+        else if (arg == "--snapshot") snapshotPath = argv[i + 1];
+        else if (arg == "--chunk-index") chunkIndexPath = argv[i + 1];
+        else if (arg == "--speed") recordedSpeed = std::string_view(argv[i + 1]) == "recorded";
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (tracePath.empty() || dir.empty() || argc % 2 == 0) {
+        std::fprintf(stderr, "usage: leveldbminimal_replay --trace <file> --db <dir> [--speed recorded|max] [--out file] [--snapshot file] [--chunk-index file]\n");
+        return 2;
+    }
+
+    std::ifstream in(tracePath, std::ios::binary | std::ios::ate);
+    if (!in) {
+        std::fprintf(stderr, "failed to read %s\n", tracePath.c_str());
+        return 1;
+    }
+    std::vector<uint8_t> data(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(data.data()), data.size());
+    uint32_t version = 0;
+    if (data.size() < 16 || std::memcmp(data.data(), kRecordMagic, 8) != 0 || (std::memcpy(&version, data.data() + 8, 4), version != kRecordVersion)) {
+        std::fprintf(stderr, "%s is not a version %u call recording\n", tracePath.c_str(), kRecordVersion);
+        return 1;
+    }
+
+    std::vector<Call> calls;
+    TraceReader reader(data.data() + 16, data.data() + data.size());
+    while (!reader.AtEnd()) {
+        Call call;
+        if (!reader.ReadCall(call)) {
+            std::fprintf(stderr, "recording truncated after %zu calls\n", calls.size());
+            break;
+        }
+        calls.push_back(std::move(call));
+    }
+    std::stable_sort(calls.begin(), calls.end(), [](const Call& a, const Call& b) { return a.startMicros < b.startMicros; });
+
+    std::vector<OpLatencies> latencies(kRecOpCount);
+    auto start = Clock::now();
+    uint64_t firstMicros = calls.empty() ? 0 : calls.front().startMicros;
+    {
+        Replayer replayer(dir, snapshotPath, chunkIndexPath);
+        for (const Call& c : calls) {
+            if (recordedSpeed) std::this_thread::sleep_until(start + std::chrono::microseconds(c.startMicros - firstMicros));
+            auto callStart = Clock::now();
+            replayer.Run(c);
+            latencies[c.op].replayed.push_back((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - callStart).count());
+            latencies[c.op].recorded.push_back(c.durationNanos);
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    double recordedSeconds = calls.empty() ? 0 : (calls.back().startMicros - firstMicros) / 1e6;
+
+    FILE* f = outPath.empty() ? stdout : std::fopen(outPath.c_str(), "w");
+    if (!f) {
+        std::fprintf(stderr, "failed to write %s\n", outPath.c_str());
+        return 1;
+    }
+    std::fprintf(f, "{\n  \"calls\": %zu,\n  \"speed\": \"%s\",\n  \"recorded_seconds\": %.3f,\n  \"replay_seconds\": %.3f,\n  \"ops\": [",
+        calls.size(), recordedSpeed ? "recorded" : "max", recordedSeconds, seconds);
+    bool first = true;
+    for (int op = 1; op < kRecOpCount; ++op) {
+        auto& l = latencies[op];
+        if (l.replayed.empty()) continue;
+        std::fprintf(f, "%s\n    {\"name\": \"%s\", \"count\": %zu, ", first ? "" : ",", kOps[op].name, l.replayed.size());
+        WriteLatencies(f, "recorded", l.recorded);
+        std::fprintf(f, ", ");
+        WriteLatencies(f, "replayed", l.replayed);
+        std::fprintf(f, "}");
+        first = false;
+    }
+    std::fprintf(f, "\n  ]\n}\n");
+    if (f != stdout) std::fclose(f);
+    return 0;
+}
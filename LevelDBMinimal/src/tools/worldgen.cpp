@@ -0,0 +1,609 @@
+// leveldbminimal_worldgen: writes a synthetic Bedrock-shaped db directory for scale tests.
+//
+// leveldbminimal_worldgen --out <dir> [--world N] [--dims N] [--hit-ratio R] [--subchunks N]
+//                         [--value-size B] [--table-bytes B] [--levels N] [--l0-files N]
+//                         [--l0-fraction R] [--overwrites R] [--tombstones R] [--villages N]
+//                         [--log-bytes B] [--compression none|zlib] [--seed N]
+//
+// Every dimension is a square of N x N chunks around the origin. Each chunk gets the usual
+// Data3D, Version, FinalizedState and SubChunkPrefix records, and with probability hit-ratio an
+// AABB volume record (tag 0x77). The records are spread over L1..Ln, each level ten times the
+// one above it, plus overlapping L0 files. Some keys also get a newer copy or a tombstone in a
+// shallower level. A .log with WriteBatches on top, a MANIFEST and CURRENT complete the db.
+// The same arguments always give the same bytes.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "leveldb/comparator.h"
+#include "leveldb/table_builder.h"
+#include "leveldb/write_batch.h"
+
+constexpr uint8_t kData3DTag = 0x2B;
+constexpr uint8_t kVersionTag = 0x2C;
+constexpr uint8_t kSubChunkPrefixTag = 0x2F;
+constexpr uint8_t kFinalizedStateTag = 0x36;
+constexpr uint8_t kAABBVolumesTag = 0x77;
+
+constexpr uint8_t kTypeDeletion = 0;
+constexpr uint8_t kTypeValue = 1;
+
+constexpr uint64_t kLogBlockSize = 32768;
+constexpr uint64_t kLogHeaderSize = 7;
+enum LogRecordType : uint8_t { kFullType = 1, kFirstType = 2, kMiddleType = 3, kLastType = 4 };
+
+struct GenConfig {
+    std::string out;
+    int32_t world = 256;          // Chunks per side of every dimension
+    int32_t dims = 1;             // Overworld, then Nether and End with 13-byte keys
+    double hitRatio = 0.3;        // Chunks with an AABB volume record
+    int32_t subchunks = 4;
+    int32_t valueSize = 2048;     // SubChunkPrefix value bytes
+    uint64_t tableBytes = 2 << 20;
+    int32_t levels = 3;
+    int32_t l0Files = 4;
+    double l0Fraction = 0.02;     // Keys whose only version lives in L0
+    double overwrites = 0.05;     // Keys with a newer value in a shallower level
+    double tombstones = 0.01;     // Keys deleted in a shallower level
+    int32_t villages = 64;
+    uint64_t logBytes = 1 << 20;
+    leveldb::CompressionType compression = leveldb::kZlibRawCompression;
+    uint64_t seed = 1;
+};
+
+static uint64_t Mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull; // splitmix64
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static double Unit(uint64_t h) { return (h >> 11) * (1.0 / 9007199254740992.0); }
+
+static void PutFixed32(std::string& s, uint32_t v) { char b[4]; std::memcpy(b, &v, 4); s.append(b, 4); }
+static void PutFixed64(std::string& s, uint64_t v) { char b[8]; std::memcpy(b, &v, 8); s.append(b, 8); }
+static void PutInt16(std::string& s, uint16_t v) { char b[2]; std::memcpy(b, &v, 2); s.append(b, 2); }
+static int32_t GetInt32(const char* p) { int32_t v; std::memcpy(&v, p, 4); return v; }
+
+static void PutVarint64(std::string& s, uint64_t v) {
+    while (v >= 0x80) { s.push_back(char(v | 0x80)); v >>= 7; }
+    s.push_back(char(v));
+}
+
+static void PutLengthPrefixed(std::string& s, std::string_view v) {
+    PutVarint64(s, v.size());
+    s.append(v);
+}
+
+// CRC32C (Castagnoli) as used by the leveldb log format, with its masking.
+static uint32_t Crc32c(uint32_t crc, const uint8_t* p, size_t n) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1)));
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t MaskCrc(uint32_t crc) { return ((crc >> 15) | (crc << 17)) + 0xA282EAD8u; }
+
+// leveldb's log writer: records fragmented over 32 KiB blocks, shared by the MANIFEST and the .log.
+class LogWriter {
+public:
+    explicit LogWriter(std::ofstream& out) : out_(out) {}
+
+    void AddRecord(std::string_view record) {
+        const char* p = record.data();
+        size_t left = record.size();
+        bool begin = true;
+        do {
+            uint64_t leftInBlock = kLogBlockSize - blockOffset_;
+            if (leftInBlock < kLogHeaderSize) {
+                static const char zeros[kLogHeaderSize] = {};
+                out_.write(zeros, leftInBlock);
+                blockOffset_ = 0;
+                leftInBlock = kLogBlockSize;
+            }
+            size_t fragment = (size_t)std::min<uint64_t>(left, leftInBlock - kLogHeaderSize);
+            bool end = fragment == left;
+            LogRecordType type = begin && end ? kFullType : begin ? kFirstType : end ? kLastType : kMiddleType;
+            EmitFragment(type, p, fragment);
+            p += fragment;
+            left -= fragment;
+            begin = false;
+        } while (left > 0);
+    }
+
+    uint64_t Size() const { return size_; }
+
+private:
+    void EmitFragment(LogRecordType type, const char* p, size_t n) {
+        uint8_t t = type;
+        uint32_t crc = MaskCrc(Crc32c(Crc32c(0, &t, 1), reinterpret_cast<const uint8_t*>(p), n));
+        char header[kLogHeaderSize];
+        std::memcpy(header, &crc, 4);
+        header[4] = char(n & 0xFF);
+        header[5] = char(n >> 8);
+        header[6] = char(type);
+        out_.write(header, kLogHeaderSize);
+        out_.write(p, n);
+        blockOffset_ = (blockOffset_ + kLogHeaderSize + n) % kLogBlockSize;
+        size_ += kLogHeaderSize + n;
+    }
+
+    std::ofstream& out_;
+    uint64_t blockOffset_ = 0;
+    uint64_t size_ = 0;
+};
+
+// Orders internal keys the way leveldb does: user key ascending, then sequence descending. Index
+// keys are kept whole; the tables only need to be readable, not minimal.
+class InternalKeyComparator : public leveldb::Comparator {
+public:
+    int Compare(const leveldb::Slice& a, const leveldb::Slice& b) const override {
+        int r = leveldb::Slice(a.data(), a.size() - 8).compare(leveldb::Slice(b.data(), b.size() - 8));
+        if (r != 0) return r;
+        uint64_t ta, tb;
+        std::memcpy(&ta, a.data() + a.size() - 8, 8);
+        std::memcpy(&tb, b.data() + b.size() - 8, 8);
+        return ta > tb ? -1 : ta < tb ? 1 : 0;
+    }
+    const char* Name() const override { return "leveldb.InternalKeyComparator"; }
+    void FindShortestSeparator(std::string*, const leveldb::Slice&) const override {}
+    void FindShortSuccessor(std::string*) const override {}
+};
+
+static std::string InternalKey(std::string_view userKey, uint64_t sequence, uint8_t type) {
+    std::string key(userKey);
+    PutFixed64(key, (sequence << 8) | type);
+    return key;
+}
+
+static std::string ChunkKey(int32_t x, int32_t z, int32_t dim, uint8_t tag) {
+    std::string key;
+    PutFixed32(key, (uint32_t)x);
+    PutFixed32(key, (uint32_t)z);
+    if (dim != 0) PutFixed32(key, (uint32_t)dim);
+    key.push_back((char)tag);
+    return key;
+}
+
+// Block data with runs of repeated bytes, so it compresses about as well as real subchunks.
+static std::string FillerValue(size_t size, uint64_t h) {
+    std::string value;
+    value.reserve(size);
+    while (value.size() < size) {
+        h = Mix(h);
+        size_t run = std::min<size_t>(1 + (h & 15), size - value.size());
+        value.append(run, char(h >> 8));
+    }
+    return value;
+}
+
+// The layout ParseAABBVolumes reads: version, structure names, volumes, dynamic and static spawns.
+static std::string AABBVolumesValue(int32_t cx, int32_t cz, uint64_t h) {
+    static constexpr std::string_view kStructures[] = { "minecraft:fortress", "minecraft:monument", "minecraft:pillager_outpost", "minecraft:swamp_hut" };
+    int32_t count = 1 + int32_t(h % 3);
+    std::string value;
+    PutFixed32(value, 1);
+    PutFixed32(value, 1);
+    auto structure = kStructures[(h >> 8) % std::size(kStructures)];
+    PutFixed32(value, 0);
+    PutInt16(value, (uint16_t)structure.size());
+    value.append(structure);
+
+    PutFixed32(value, (uint32_t)count);
+    for (int32_t i = 0; i < count; i++) {
+        h = Mix(h);
+        int32_t x0 = cx * 16 + int32_t(h & 7), z0 = cz * 16 + int32_t((h >> 3) & 7), y0 = -64 + int32_t((h >> 6) % 256);
+        PutFixed32(value, (uint32_t)i);
+        for (int32_t v : { x0, y0, z0, x0 + 4 + int32_t((h >> 16) & 7), y0 + 4 + int32_t((h >> 19) & 15), z0 + 4 + int32_t((h >> 23) & 7) })
+            PutFixed32(value, (uint32_t)v);
+    }
+    PutFixed32(value, 0);
+    PutFixed32(value, (uint32_t)count);
+    for (int32_t i = 0; i < count; i++) {
+        PutFixed32(value, (uint32_t)i);
+        PutFixed64(value, 0);
+        PutFixed32(value, (uint32_t)((h >> (40 + i)) & 1));
+    }
+    return value;
+}
+
+// VILLAGE_*_INFO: a root compound with the X0..Z1 bounds ParseVillageInfo looks for.
+static std::string VillageInfoValue(uint64_t h, int32_t world) {
+    auto tag = [](std::string& s, uint8_t type, std::string_view name) {
+        s.push_back((char)type);
+        PutInt16(s, (uint16_t)name.size());
+        s.append(name);
+    };
+    std::string value;
+    tag(value, 0x0A, "");
+    tag(value, 0x04, "BDTime");
+    PutFixed64(value, h & 0xFFFFFF);
+    tag(value, 0x01, "Initialized");
+    value.push_back(1);
+    int32_t x = (int32_t)(Mix(h) % uint64_t(world * 16)) - world * 8;
+    int32_t z = (int32_t)(Mix(h + 1) % uint64_t(world * 16)) - world * 8;
+    int32_t y = 60 + int32_t(h % 16);
+    const std::pair<std::string_view, int32_t> bounds[] = {
+        { "X0", x }, { "Y0", y }, { "Z0", z }, { "X1", x + 64 }, { "Y1", y + 24 }, { "Z1", z + 64 },
+    };
+    for (auto& [name, v] : bounds) {
+        tag(value, 0x03, name);
+        PutFixed32(value, (uint32_t)v);
+    }
+    value.push_back(0);
+    return value;
+}
+
+static std::string ValueFor(std::string_view key, uint64_t h, const GenConfig& cfg) {
+    if (key.starts_with("VILLAGE_")) {
+        if (key.ends_with("_INFO")) return VillageInfoValue(h, cfg.world);
+        return FillerValue(64 + h % 192, h);
+    }
+    bool sub = key.size() == 10 || key.size() == 14;
+    uint8_t tag = (uint8_t)key[key.size() - (sub ? 2 : 1)];
+    switch (tag) {
+    case kAABBVolumesTag: return AABBVolumesValue(GetInt32(key.data()), GetInt32(key.data() + 4), h);
+    case kVersionTag: return std::string(1, char(40));
+    case kFinalizedStateTag: return std::string(4, '\2');
+    case kData3DTag: return FillerValue(768, h);
+    default: return FillerValue((size_t)cfg.valueSize, h);
+    }
+}
+
+static void AddChunkKeys(std::vector<std::string>& keys, int32_t x, int32_t z, int32_t dim, const GenConfig& cfg) {
+    keys.push_back(ChunkKey(x, z, dim, kData3DTag));
+    keys.push_back(ChunkKey(x, z, dim, kVersionTag));
+    keys.push_back(ChunkKey(x, z, dim, kFinalizedStateTag));
+    for (int32_t i = 0; i < cfg.subchunks; i++) {
+        keys.push_back(ChunkKey(x, z, dim, kSubChunkPrefixTag));
+        keys.back().push_back(char(i));
+    }
+    if (Unit(Mix(cfg.seed ^ Mix(uint64_t(uint32_t(x)) << 32 | uint32_t(z)) ^ uint64_t(dim))) < cfg.hitRatio)
+        keys.push_back(ChunkKey(x, z, dim, kAABBVolumesTag));
+}
+
+static std::vector<std::string> GenerateKeys(const GenConfig& cfg) {
+    std::vector<std::string> keys;
+    int32_t lo = -cfg.world / 2, hi = lo + cfg.world;
+    for (int32_t dim = 0; dim < cfg.dims; dim++)
+        for (int32_t x = lo; x < hi; x++)
+            for (int32_t z = lo; z < hi; z++)
+                AddChunkKeys(keys, x, z, dim, cfg);
+
+    for (int32_t v = 0; v < cfg.villages; v++) {
+        uint64_t a = Mix(cfg.seed ^ (0x5649ull << 32 | uint32_t(v))), b = Mix(a);
+        char uuid[40];
+        std::snprintf(uuid, sizeof(uuid), "%08x-%04x-%04x-%04x-%012llx", uint32_t(a), uint32_t(a >> 32) & 0xFFFF,
+            uint32_t(a >> 48), uint32_t(b) & 0xFFFF, (unsigned long long)(b >> 16));
+        for (const char* suffix : { "_INFO", "_DWELLERS", "_PLAYERS", "_POI" })
+            keys.push_back(std::string("VILLAGE_") + uuid + suffix);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// Where each version of a key lives. Level 0 is L0; every key has one value in its primary level
+// and at most one newer entry, a value or a tombstone, in a shallower secondary level.
+struct KeyPlacement {
+    int32_t primary;
+    int32_t secondary = -1;
+    bool tombstone = false;
+    uint32_t l0File = 0;
+};
+
+static KeyPlacement PlaceKey(size_t index, const GenConfig& cfg) {
+    uint64_t h = Mix(cfg.seed ^ Mix(index));
+    KeyPlacement placement;
+    int32_t minLevel = cfg.l0Files > 0 ? 0 : 1;
+    double u = Unit(h);
+    if (minLevel == 0 && u < cfg.l0Fraction) {
+        placement.primary = 0;
+    }
+    else {
+        // L1..Ln, each ten times the size of the one above.
+        double total = 0, weight = 1;
+        for (int32_t l = 1; l <= cfg.levels; l++, weight *= 10) total += weight;
+        double pick = Unit(Mix(h)) * total;
+        placement.primary = cfg.levels;
+        weight = 1;
+        for (int32_t l = 1; l <= cfg.levels; l++, weight *= 10) {
+            if (pick < weight) { placement.primary = l; break; }
+            pick -= weight;
+        }
+    }
+
+    uint64_t h2 = Mix(h ^ 0x7365636F6E64ull);
+    double v = Unit(h2);
+    if (placement.primary > minLevel && v < cfg.tombstones + cfg.overwrites) {
+        placement.secondary = minLevel + int32_t((h2 >> 8) % uint64_t(placement.primary - minLevel));
+        placement.tombstone = v < cfg.tombstones;
+    }
+    if (cfg.l0Files > 0) placement.l0File = uint32_t(Mix(h2) % uint64_t(cfg.l0Files));
+    return placement;
+}
+
+struct TableMeta {
+    uint64_t number;
+    int32_t level;
+    uint64_t fileSize;
+    std::string smallest;
+    std::string largest;
+};
+
+class TableWriter {
+public:
+    TableWriter(const GenConfig& cfg, const std::filesystem::path& dir, uint64_t& nextFile, std::vector<TableMeta>& tables)
+        : cfg_(cfg), dir_(dir), nextFile_(nextFile), tables_(tables) {
+        options_.comparator = &comparator_;
+        options_.compression = cfg.compression;
+    }
+    ~TableWriter() { Finish(); }
+
+    bool Add(int32_t level, const std::string& internalKey, const std::string& value) {
+        if (builder_ && (level != level_ || builder_->FileSize() >= cfg_.tableBytes)) {
+            if (!Finish()) return false;
+        }
+        if (!builder_) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%06llu.ldb", (unsigned long long)nextFile_);
+            auto path = (dir_ / name).string();
+            if (!leveldb::Env::Default()->NewWritableFile(path, &file_).ok()) {
+                std::fprintf(stderr, "failed to create %s\n", path.c_str());
+                return false;
+            }
+            builder_ = new leveldb::TableBuilder(options_, file_);
+            tables_.push_back({ nextFile_++, level, 0, internalKey, internalKey });
+            level_ = level;
+        }
+        builder_->Add(internalKey, value);
+        tables_.back().largest = internalKey;
+        return true;
+    }
+
+    bool Finish() {
+        if (!builder_) return true;
+        bool ok = builder_->Finish().ok();
+        tables_.back().fileSize = builder_->FileSize();
+        delete builder_;
+        builder_ = nullptr;
+        ok = ok && file_->Sync().ok() && file_->Close().ok();
+        delete file_;
+        file_ = nullptr;
+        if (!ok) std::fprintf(stderr, "failed to write table %06llu\n", (unsigned long long)tables_.back().number);
+        return ok;
+    }
+
+private:
+    const GenConfig& cfg_;
+    std::filesystem::path dir_;
+    uint64_t& nextFile_;
+    std::vector<TableMeta>& tables_;
+    InternalKeyComparator comparator_;
+    leveldb::Options options_;
+    leveldb::WritableFile* file_ = nullptr;
+    leveldb::TableBuilder* builder_ = nullptr;
+    int32_t level_ = -1;
+};
+
+// The public WriteBatch keeps its encoding private; this rebuilds it from the batch's contents:
+// sequence(8) count(4) then type, key and value for every entry.
+class BatchEncoder : public leveldb::WriteBatch::Handler {
+public:
+    explicit BatchEncoder(uint64_t sequence) { PutFixed64(rep, sequence); PutFixed32(rep, 0); }
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+        rep.push_back((char)kTypeValue);
+        PutLengthPrefixed(rep, std::string_view(key.data(), key.size()));
+        PutLengthPrefixed(rep, std::string_view(value.data(), value.size()));
+        count++;
+    }
+    void Delete(const leveldb::Slice& key) override {
+        rep.push_back((char)kTypeDeletion);
+        PutLengthPrefixed(rep, std::string_view(key.data(), key.size()));
+        count++;
+    }
+    std::string Finish() { std::memcpy(rep.data() + 8, &count, 4); return std::move(rep); }
+
+    std::string rep;
+    uint32_t count = 0;
+};
+
+// Edits the running game would have logged: chunks rewritten around a few wandering players.
+static bool WriteLog(const GenConfig& cfg, const std::filesystem::path& file, uint64_t& sequence) {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    LogWriter log(out);
+    uint64_t h = Mix(cfg.seed ^ 0x6C6F67ull);
+    int32_t px = 0, pz = 0;
+    while (log.Size() < cfg.logBytes) {
+        h = Mix(h);
+        px = std::clamp(px + int32_t(h % 5) - 2, -cfg.world / 2, cfg.world / 2 - 1);
+        pz = std::clamp(pz + int32_t((h >> 8) % 5) - 2, -cfg.world / 2, cfg.world / 2 - 1);
+        int32_t dim = int32_t((h >> 16) % uint64_t(cfg.dims));
+
+        leveldb::WriteBatch batch;
+        for (int32_t i = 0; i < cfg.subchunks; i++) {
+            std::string key = ChunkKey(px, pz, dim, kSubChunkPrefixTag);
+            key.push_back(char(i));
+            if (Unit(Mix(h + i)) < cfg.tombstones) batch.Delete(key);
+            else batch.Put(key, FillerValue((size_t)cfg.valueSize, Mix(h ^ uint64_t(i))));
+        }
+        if (Unit(Mix(h ^ 0x77)) < cfg.hitRatio)
+            batch.Put(ChunkKey(px, pz, dim, kAABBVolumesTag), AABBVolumesValue(px, pz, h));
+        batch.Put(ChunkKey(px, pz, dim, kVersionTag), std::string(1, char(40)));
+
+        BatchEncoder encoder(sequence);
+        if (!batch.Iterate(&encoder).ok()) return false;
+        sequence += encoder.count;
+        log.AddRecord(encoder.Finish());
+    }
+    return (bool)out.flush();
+}
+
+static bool WriteManifest(const std::filesystem::path& dir, uint64_t manifestNumber, uint64_t logNumber, uint64_t nextFile,
+    uint64_t lastSequence, const std::vector<TableMeta>& tables) {
+    std::string edit;
+    PutVarint64(edit, 1);
+    PutLengthPrefixed(edit, "leveldb.BytewiseComparator");
+    PutVarint64(edit, 2);
+    PutVarint64(edit, logNumber);
+    PutVarint64(edit, 3);
+    PutVarint64(edit, nextFile);
+    PutVarint64(edit, 4);
+    PutVarint64(edit, lastSequence);
+    for (auto& t : tables) {
+        PutVarint64(edit, 7);
+        PutVarint64(edit, (uint64_t)t.level);
+        PutVarint64(edit, t.number);
+        PutVarint64(edit, t.fileSize);
+        PutLengthPrefixed(edit, t.smallest);
+        PutLengthPrefixed(edit, t.largest);
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "MANIFEST-%06llu", (unsigned long long)manifestNumber);
+    {
+        std::ofstream out(dir / name, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        LogWriter(out).AddRecord(edit);
+        if (!out.flush()) return false;
+    }
+    std::ofstream current(dir / "CURRENT", std::ios::binary | std::ios::trunc);
+    current << name << '\n';
+    return (bool)current.flush();
+}
+
+static bool ParseArgs(int argc, char** argv, GenConfig& cfg) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n", argv[i]);
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--out") cfg.out = value;
+        else if (arg == "--world") cfg.world = std::max(1, std::atoi(value));
+        else if (arg == "--dims") cfg.dims = std::clamp(std::atoi(value), 1, 3);
+        else if (arg == "--hit-ratio") cfg.hitRatio = std::clamp(std::atof(value), 0.0, 1.0);
+        else if (arg == "--subchunks") cfg.subchunks = std::clamp(std::atoi(value), 0, 24);
+        else if (arg == "--value-size") cfg.valueSize = std::max(0, std::atoi(value));
+        else if (arg == "--table-bytes") cfg.tableBytes = std::max<uint64_t>(4096, std::strtoull(value, nullptr, 10));
+        else if (arg == "--levels") cfg.levels = std::clamp(std::atoi(value), 1, 6);
+        else if (arg == "--l0-files") cfg.l0Files = std::clamp(std::atoi(value), 0, 64);
+        else if (arg == "--l0-fraction") cfg.l0Fraction = std::clamp(std::atof(value), 0.0, 1.0);
+        else if (arg == "--overwrites") cfg.overwrites = std::clamp(std::atof(value), 0.0, 1.0);
+        else if (arg == "--tombstones") cfg.tombstones = std::clamp(std::atof(value), 0.0, 1.0);
+        else if (arg == "--villages") cfg.villages = std::max(0, std::atoi(value));
+        else if (arg == "--log-bytes") cfg.logBytes = std::strtoull(value, nullptr, 10);
+        else if (arg == "--seed") cfg.seed = std::strtoull(value, nullptr, 10);
+        else if (arg == "--compression") {
+            std::string_view name = value;
+            if (name == "none") cfg.compression = leveldb::kNoCompression;
+            else if (name == "zlib") cfg.compression = leveldb::kZlibRawCompression;
+            else {
+                std::fprintf(stderr, "unknown compression %s\n", value);
+                return false;
+            }
+        }
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i - 1]);
+            return false;
+        }
+    }
+    if (cfg.out.empty()) {
+        std::fprintf(stderr, "usage: leveldbminimal_worldgen --out <dir> [--world N] [--dims N] [--hit-ratio R] [--subchunks N] [--value-size B]\n"
+            "    [--table-bytes B] [--levels N] [--l0-files N] [--l0-fraction R] [--overwrites R] [--tombstones R]\n"
+            "    [--villages N] [--log-bytes B] [--compression none|zlib] [--seed N]\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    GenConfig cfg;
+    if (!ParseArgs(argc, argv, cfg)) return 2;
+
+    std::filesystem::path dir(cfg.out);
+    std::error_code ec;
+    if (std::filesystem::exists(dir, ec) && !std::filesystem::is_empty(dir, ec)) {
+        std::fprintf(stderr, "%s exists and is not empty\n", cfg.out.c_str());
+        return 1;
+    }
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::fprintf(stderr, "failed to create %s\n", cfg.out.c_str());
+        return 1;
+    }
+
+    auto keys = GenerateKeys(cfg);
+    const uint64_t manifestNumber = 1;
+    uint64_t nextFile = 2, sequence = 1;
+    std::vector<TableMeta> tables;
+    uint64_t entries = 0, deletions = 0;
+
+    // Oldest first: the deepest level gets the lowest sequence numbers, L0 file j is newer than j - 1.
+    {
+        TableWriter writer(cfg, dir, nextFile, tables);
+        auto pass = [&](int32_t level, uint32_t l0File) {
+            for (size_t i = 0; i < keys.size(); i++) {
+                KeyPlacement placement = PlaceKey(i, cfg);
+                bool primary = placement.primary == level, secondary = placement.secondary == level;
+                if (!primary && !secondary) continue;
+                if (level == 0 && placement.l0File != l0File) continue;
+                bool deletion = secondary && placement.tombstone;
+                std::string value = deletion ? std::string() : ValueFor(keys[i], Mix(cfg.seed ^ Mix(i) ^ uint64_t(level)), cfg);
+                if (!writer.Add(level, InternalKey(keys[i], sequence++, deletion ? kTypeDeletion : kTypeValue), value)) return false;
+                entries++;
+                deletions += deletion;
+            }
+            return writer.Finish();
+        };
+        for (int32_t level = cfg.levels; level >= 1; level--)
+            if (!pass(level, 0)) return 1;
+        for (int32_t f = 0; f < cfg.l0Files; f++)
+            if (!pass(0, (uint32_t)f)) return 1;
+    }
+
+    uint64_t lastSequence = sequence - 1;
+    uint64_t logNumber = nextFile++;
+    char logName[32];
+    std::snprintf(logName, sizeof(logName), "%06llu.log", (unsigned long long)logNumber);
+    if (!WriteLog(cfg, dir / logName, sequence)) {
+        std::fprintf(stderr, "failed to write %s\n", logName);
+        return 1;
+    }
+    if (!WriteManifest(dir, manifestNumber, logNumber, nextFile, lastSequence, tables)) {
+        std::fprintf(stderr, "failed to write the MANIFEST\n");
+        return 1;
+    }
+
+    std::vector<uint32_t> perLevel(cfg.levels + 1, 0);
+    uint64_t tableBytes = 0;
+    for (auto& t : tables) { perLevel[t.level]++; tableBytes += t.fileSize; }
+    std::printf("{\n  \"out\": \"%s\",\n  \"keys\": %llu,\n  \"entries\": %llu,\n  \"tombstones\": %llu,\n  \"tables\": %llu,\n  \"table_bytes\": %llu,\n  \"tables_per_level\": [",
+        dir.generic_string().c_str(), (unsigned long long)keys.size(), (unsigned long long)entries, (unsigned long long)deletions,
+        (unsigned long long)tables.size(), (unsigned long long)tableBytes);
+    for (size_t l = 0; l < perLevel.size(); l++) std::printf("%s%u", l ? ", " : "", perLevel[l]);
+    std::printf("],\n  \"log_bytes\": %llu,\n  \"last_sequence\": %llu\n}\n",
+        (unsigned long long)std::filesystem::file_size(dir / logName, ec), (unsigned long long)(sequence - 1));
+    return 0;
+}